@@ -0,0 +1,251 @@
+// compares the spatial indices (quad tree, linear quad tree, k-d tree) on
+// flocks with different distributions. for each of them it measures the time
+// to build the index and to query the neighbours of every boid. the boids of
+// a checkpoint can be measured as well, to compare the indices on a known
+// state of the simulation.
+// usage: boid.bench [number of boids]
+//        boid.bench --checkpoint file
+#include <chrono>
+#include <cmath>
+#include <cstdlib>  //for std::atoi
+#include <fstream>
+#include <iomanip>  //for std::setw
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "./../boid.hpp"
+#include "./../checkpoint.hpp"
+#include "./../kd_tree.hpp"
+#include "./../linear_quadtree.hpp"
+#include "./../point.hpp"
+#include "./../quadtree.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// range used for the queries
+constexpr double range{40.};
+// average number of boids within range in the uniform flock
+constexpr double mean_neighbours{10.};
+// number of steps of the streaming flock
+constexpr int streaming_steps{10};
+
+double milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// side of the square world, chosen so that the uniform flock has
+// mean_neighbours boids in range
+double world_side(int boid_number) {
+  return std::sqrt(boid_number * constants::pi * range * range /
+                   mean_neighbours);
+}
+
+// boids uniformly distributed in the world
+std::vector<boids::Boid> uniform_flock(int boid_number, double side,
+                                       std::mt19937& mt) {
+  std::uniform_real_distribution<double> coordinate{0., side};
+  std::vector<boids::Boid> flock;
+  flock.reserve(boid_number);
+  for (int i = 0; i != boid_number; ++i) {
+    flock.push_back(
+        boids::Boid{boids::Point{coordinate(mt), coordinate(mt)}});
+  }
+  return flock;
+}
+
+// boids gathered in a few dense balls, in the same world as the uniform flock
+std::vector<boids::Boid> clustered_flock(int boid_number, double side,
+                                         std::mt19937& mt) {
+  constexpr int clusters{5};
+  std::uniform_real_distribution<double> center{0.1 * side, 0.9 * side};
+  std::vector<boids::Point> centers;
+  for (int i = 0; i != clusters; ++i) {
+    centers.push_back(boids::Point{center(mt), center(mt)});
+  }
+
+  std::normal_distribution<double> offset{0., 0.02 * side};
+  std::vector<boids::Boid> flock;
+  flock.reserve(boid_number);
+  for (int i = 0; i != boid_number; ++i) {
+    flock.push_back(boids::Boid{centers[i % clusters] +
+                                boids::Point{offset(mt), offset(mt)}});
+  }
+  return flock;
+}
+
+// boids in a narrow band on the left of the world, flying to the right. the
+// band leaves the mother cell of the quad trees during the run
+std::vector<boids::Boid> streaming_flock(int boid_number, double side,
+                                         std::mt19937& mt) {
+  std::uniform_real_distribution<double> x{0., 0.1 * side};
+  std::uniform_real_distribution<double> y{0., side};
+  std::uniform_real_distribution<double> speed{0.5, 1.5};
+  std::vector<boids::Boid> flock;
+  flock.reserve(boid_number);
+  for (int i = 0; i != boid_number; ++i) {
+    flock.push_back(boids::Boid{boids::Point{x(mt), y(mt)},
+                                boids::Point{0.15 * side * speed(mt), 0.}});
+  }
+  return flock;
+}
+
+// moves every boid by its velocity
+void advance(std::vector<boids::Boid>& flock) {
+  for (auto& boid : flock) {
+    boid = boids::Boid{boid.pos() + boid.vel(), boid.vel()};
+  }
+}
+
+struct Result {
+  double build_ms{};
+  double query_ms{};
+  long long neighbours{};
+};
+
+// builds the index with the first function and queries every boid with the
+// second, repeating for the provided number of steps and moving the flock
+// after each
+template <class Build, class Query>
+Result measure(Build build, Query query, std::vector<boids::Boid> flock,
+               int steps) {
+  Result result;
+  std::vector<const boids::Boid*> in_range;
+  for (int step = 0; step != steps; ++step) {
+    auto start = Clock::now();
+    build(flock);
+    auto built = Clock::now();
+    for (const auto& boid : flock) {
+      in_range.clear();
+      query(boid, in_range);
+      result.neighbours += in_range.size();
+    }
+    auto queried = Clock::now();
+
+    result.build_ms += milliseconds(built - start);
+    result.query_ms += milliseconds(queried - built);
+    advance(flock);
+  }
+  return result;
+}
+
+void print(const std::string& distribution, const std::string& index,
+           const Result& result) {
+  std::cout << std::left << std::setw(12) << distribution << std::setw(18)
+            << index << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << result.build_ms << std::setw(12)
+            << result.query_ms << std::setw(14) << result.neighbours << '\n';
+}
+
+void run(const std::string& distribution,
+         const std::vector<boids::Boid>& flock,
+         const boids::Rectangle& world, int steps) {
+  // the quad tree is rebuilt from scratch at every step, as in the game
+  std::optional<boids::Quad_tree> quad_tree;
+  print(distribution, "quad tree",
+        measure(
+            [&](const std::vector<boids::Boid>& boids) {
+              quad_tree.emplace(constants::cell_capacity, world);
+              for (const auto& boid : boids) {
+                quad_tree->insert(boid);
+              }
+            },
+            [&](const boids::Boid& boid,
+                std::vector<const boids::Boid*>& in_range) {
+              quad_tree->query(range, boid, in_range);
+            },
+            flock, steps));
+
+  boids::Linear_quad_tree linear_tree{constants::cell_capacity, world};
+  print(distribution, "linear quad tree",
+        measure(
+            [&](const std::vector<boids::Boid>& boids) {
+              linear_tree.build(boids);
+            },
+            [&](const boids::Boid& boid,
+                std::vector<const boids::Boid*>& in_range) {
+              linear_tree.query(range, boid, in_range);
+            },
+            flock, steps));
+
+  boids::Kd_tree kd_tree{constants::cell_capacity};
+  print(distribution, "k-d tree",
+        measure(
+            [&](const std::vector<boids::Boid>& boids) {
+              kd_tree.build(boids);
+            },
+            [&](const boids::Boid& boid,
+                std::vector<const boids::Boid*>& in_range) {
+              kd_tree.query(range, boid, in_range);
+            },
+            flock, steps));
+}
+
+// square world with the provided side
+boids::Rectangle square(double side) {
+  return boids::Rectangle{side / 2., side / 2., side / 2., side / 2.};
+}
+
+void print_header() {
+  std::cout << std::left << std::setw(12) << "flock" << std::setw(18)
+            << "index" << std::right << std::setw(12) << "build [ms]"
+            << std::setw(12) << "query [ms]" << std::setw(14) << "neighbours"
+            << '\n';
+}
+
+// measures the indices on the boids of the checkpoint, in its world
+int run_checkpoint(const char* file_name) {
+  std::ifstream file{file_name, std::ios::binary};
+  if (!file) {
+    std::cerr << "cannot open " << file_name << '\n';
+    return 1;
+  }
+  boids::Checkpoint checkpoint;
+  try {
+    checkpoint = boids::read_checkpoint(file);
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+
+  const boids::World& world = checkpoint.config.world;
+  std::cout << checkpoint.boids.size() << " boids, range " << range
+            << ", world " << world.width << " x " << world.height << "\n\n";
+  print_header();
+  run("checkpoint", checkpoint.boids,
+      boids::Rectangle{world.min_x + world.width / 2.,
+                       world.min_y + world.height / 2., world.width / 2.,
+                       world.height / 2.},
+      1);
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc == 3 && std::string{argv[1]} == "--checkpoint") {
+    return run_checkpoint(argv[2]);
+  }
+
+  int boid_number = argc > 1 ? std::atoi(argv[1]) : 100000;
+  if (boid_number <= 0) {
+    std::cerr << "usage: boid.bench [number of boids]\n"
+              << "       boid.bench --checkpoint file\n";
+    return 1;
+  }
+
+  std::mt19937 mt{12345};
+  double side = world_side(boid_number);
+
+  std::cout << boid_number << " boids, range " << range << ", world side "
+            << side << "\n\n";
+  print_header();
+
+  run("uniform", uniform_flock(boid_number, side, mt), square(side), 1);
+  run("clustered", clustered_flock(boid_number, side, mt), square(side), 1);
+  run("streaming", streaming_flock(boid_number, side, mt), square(side),
+      streaming_steps);
+}
@@ -4,6 +4,8 @@
 #include <cassert>
 #include <cmath>  //for isnan
 
+#include "config.hpp"
+
 namespace boids {
 
 // Bird methods
@@ -13,28 +15,33 @@ Point Bird::pos() const { return m_pos; }
 
 Point Bird::vel() const { return m_vel; }
 
-Point Bird::turn_around() {
+Point Bird::turn_around(const Config& config) {
+  const World& world = config.world;
+  double turn = config.turn_coefficent;
   Point added_velocity{0., 0.};
+  // a toroidal world has no margins
+  if (world.toroidal) return added_velocity;
+
   // if exiting the margins, force pushes towards center
-  if (m_pos.x() > constants::window_width - constants::margin_size)
-    added_velocity = added_velocity + Point{-constants::turn_coefficent, 0.};
-  if (m_pos.x() < constants::margin_size + constants::controls_width)
-    added_velocity = added_velocity + Point{constants::turn_coefficent, 0.};
-  if (m_pos.y() > constants::window_height - constants::margin_size)
-    added_velocity = added_velocity + Point{0., -constants::turn_coefficent};
-  if (m_pos.y() < constants::margin_size)
-    added_velocity = added_velocity + Point{0., constants::turn_coefficent};
+  if (m_pos.x() > world.min_x + world.width - config.margin_size)
+    added_velocity = added_velocity + Point{-turn, 0.};
+  if (m_pos.x() < world.min_x + config.margin_size)
+    added_velocity = added_velocity + Point{turn, 0.};
+  if (m_pos.y() > world.min_y + world.height - config.margin_size)
+    added_velocity = added_velocity + Point{0., -turn};
+  if (m_pos.y() < world.min_y + config.margin_size)
+    added_velocity = added_velocity + Point{0., turn};
   return added_velocity;
 }
 
 void Bird::repel(const Point& point, double repulsion_range,
-                 double repulsion_coeff) {
+                 double repulsion_coeff, const Config& config) {
   // it handels division by zero (point position = bird position)
-  double distance = (pos() - point).distance();
+  Point difference = config.world.displacement(m_pos, point);
+  double distance = difference.distance();
 
   if (distance < repulsion_range && distance != 0.) {
-    m_vel = m_vel + repulsion_coeff * 1. / ((m_pos - point).distance()) *
-                        (m_pos - point);
+    m_vel = m_vel + repulsion_coeff * 1. / distance * difference;
   }
 
   assert(!std::isnan(m_vel.x()));
@@ -43,7 +50,8 @@ void Bird::repel(const Point& point, double repulsion_range,
 
 // Boid methods
 Point Boid::separation(const std::vector<const Boid*>& in_range,
-                       double separation_distance, double separation_coeff) {
+                       double separation_distance, double separation_coeff,
+                       const Config& config) {
   assert(separation_distance >= 0.);
   assert(separation_coeff >= 0.);
 
@@ -52,8 +60,10 @@ Point Boid::separation(const std::vector<const Boid*>& in_range,
   for (auto other_boid_ptr : in_range) {
     assert(other_boid_ptr);
 
-    if ((m_pos - other_boid_ptr->pos()).distance() < separation_distance) {
-      added_velocity = added_velocity + (m_pos - other_boid_ptr->pos());
+    Point difference =
+        config.world.displacement(m_pos, other_boid_ptr->pos());
+    if (difference.distance() < separation_distance) {
+      added_velocity = added_velocity + difference;
     }
   }
 
@@ -61,7 +71,7 @@ Point Boid::separation(const std::vector<const Boid*>& in_range,
 }
 
 Point Boid::cohesion(const std::vector<const Boid*>& in_range,
-                     double cohesion_coeff) {
+                     double cohesion_coeff, const Config& config) {
   assert(cohesion_coeff >= 0.);
 
   Point added_velocity{0., 0.};
@@ -73,11 +83,13 @@ Point Boid::cohesion(const std::vector<const Boid*>& in_range,
   for (auto other_boid_ptr : in_range) {
     assert(other_boid_ptr);
 
-    added_velocity = added_velocity + (other_boid_ptr->pos());
+    // positions are taken relative to the boid, so that in a toroidal world
+    // boids across the edges are seen on the closest side
+    added_velocity = added_velocity +
+                     config.world.displacement(other_boid_ptr->pos(), m_pos);
   }
 
-  added_velocity =
-      cohesion_coeff * ((1. / in_range.size()) * added_velocity - m_pos);
+  added_velocity = cohesion_coeff * ((1. / in_range.size()) * added_velocity);
   return added_velocity;
 }
 
@@ -104,25 +116,28 @@ Point Boid::alignment(const std::vector<const Boid*>& in_range,
 
 void Boid::update(double delta_t, const std::vector<const Boid*>& in_range,
                   double separation_distance, double separation_coeff,
-                  double cohesion_coeff, double alignment_coeff) {
+                  double cohesion_coeff, double alignment_coeff,
+                  const Config& config) {
   assert(delta_t >= 0.);
 
-  if (m_vel.distance() < constants::max_velocity) {
+  if (m_vel.distance() < config.max_velocity) {
     m_vel = m_vel +
-            separation(in_range, separation_distance, separation_coeff) +
-            cohesion(in_range, cohesion_coeff) +
-            alignment(in_range, alignment_coeff) + turn_around();
+            separation(in_range, separation_distance, separation_coeff,
+                       config) +
+            cohesion(in_range, cohesion_coeff, config) +
+            alignment(in_range, alignment_coeff) + turn_around(config);
   } else {
-    m_vel = Point{constants::velocity_reduction_coefficent * (m_vel.x()),
-                  constants::velocity_reduction_coefficent * (m_vel.y())};
+    m_vel = Point{config.velocity_reduction_coefficent * (m_vel.x()),
+                  config.velocity_reduction_coefficent * (m_vel.y())};
   }
-  m_pos = delta_t * (m_vel) + (m_pos);
+  m_pos = config.world.wrap(delta_t * (m_vel) + (m_pos));
 }
 
 // predator methods
 
 void Predator::update(double delta_t, double predator_range,
-                      const std::vector<Boid>& boid_vec) {
+                      const std::vector<Boid>& boid_vec,
+                      const Config& config) {
   assert(predator_range >= 0.);
   assert(delta_t >= 0.);
 
@@ -130,37 +145,38 @@ void Predator::update(double delta_t, double predator_range,
   // if turn around not zero the other forces must be ignored, otherwise
   // predator may exit the screen while chasing a boid
 
-  if (m_vel.distance() < constants::max_velocity &&
-      turn_around().distance() == 0.) {
+  if (m_vel.distance() < config.max_velocity &&
+      turn_around(config).distance() == 0.) {
+    // vectors from the predator to the boids
     std::vector<Point> in_range_vector{};
 
     // finding boids in range
     for (const auto& boid : boid_vec) {
-      if ((m_pos - boid.pos()).distance() < predator_range) {
-        in_range_vector.push_back(boid.pos());
+      Point difference = config.world.displacement(boid.pos(), m_pos);
+      if (difference.distance() < predator_range) {
+        in_range_vector.push_back(difference);
       }
     }
 
     // sort to get closest boid
     std::sort(in_range_vector.begin(), in_range_vector.end(),
-              [this](const Point& a, const Point& b) {
-                return ((m_pos - a).distance() < (m_pos - b).distance());
+              [](const Point& a, const Point& b) {
+                return a.distance() < b.distance();
               });
 
     // add velocity to move towards closest boid
     if (in_range_vector.size() != 0) {
-      m_vel = m_vel +
-              constants::predator_hunting_coeff * (in_range_vector[0] - m_pos);
+      m_vel = m_vel + config.predator_hunting_coeff * in_range_vector[0];
     }
 
   }
 
   else {
-    m_vel = Point{constants::velocity_reduction_coefficent * (m_vel.x()),
-                  constants::velocity_reduction_coefficent * (m_vel.y())};
+    m_vel = Point{config.velocity_reduction_coefficent * (m_vel.x()),
+                  config.velocity_reduction_coefficent * (m_vel.y())};
   }
 
-  m_vel = m_vel + turn_around();
-  m_pos = delta_t * (m_vel) + (m_pos);
+  m_vel = m_vel + turn_around(config);
+  m_pos = config.world.wrap(delta_t * (m_vel) + (m_pos));
 }
 }  // namespace boids
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 
 #include <vector>
+#include "config.hpp"
 #include "constants.hpp"
 #include "point.hpp"
 
@@ -14,10 +15,11 @@ class Bird {
   Point m_vel{};  // velocity
 
   // adds a velocity vector to the boids, if they exit the boundary.
-  // the boundary is defined by the window, margin and control panel
-  // constants in constants.hpp. the size of the vector is determined
-  // by constants::turn_coefficent
-  Point turn_around();
+  // the boundary is the world of the configuration, reduced by its
+  // margin_size. the size of the vector is determined by its turn_coefficent.
+  // null in a toroidal world, where birds wrap around the edges instead
+  // Param 1: the configuration
+  Point turn_around(const Config&);
 
  public:
   Bird(const Point& pos = Point{}, const Point& vel = Point{});
@@ -32,8 +34,9 @@ class Bird {
   //Param 1: the point.
   //Param 2: the range.
   //Param 3: a coefficent of the force.
-  // the size of the vector is determined by constants::repel_coefficent
-  void repel(const Point&, double, double);
+  //Param 4: the configuration, for the distance across the edges of a
+  // toroidal world.
+  void repel(const Point&, double, double, const Config& = default_config);
 };
 
 class Boid;
@@ -44,12 +47,14 @@ class Predator : public Bird {
   // updates the position of a predator object. a velocity vector is added to
   // the object's speed, pointing towards the nearest boid within the provided
   // boid vector and the specified range. if predator exceeds
-  // constants::max_velocity it slows down the predator.
+  // the max_velocity of the configuration it slows down the predator.
   // Param 1: delta_t, time step in the equation of motion, affecting the speed
   // of the object.
   // Param 2: the range of the predator's vision.
   // Param 3: vector of boids.
-  void update(double, double, const std::vector<Boid>&);
+  // Param 4: the configuration.
+  void update(double, double, const std::vector<Boid>&,
+              const Config& = default_config);
 };
 
 class Boid : public Bird {
@@ -59,13 +64,16 @@ class Boid : public Bird {
   // range (itself excluded).
   // Param 2: the separation range
   // Param 3: a coefficent that determines the strength of the force
-  Point separation(const std::vector<const Boid*>&, double, double);
+  // Param 4: the configuration
+  Point separation(const std::vector<const Boid*>&, double, double,
+                   const Config&);
 
   // implements cohesion force on boid.
   // Param 1: vector containing the boids in the cohesion range (itself
   // excluded).
   // Param 2: a coefficent that determines the strength of the force;
-  Point cohesion(const std::vector<const Boid*>&, double);
+  // Param 3: the configuration
+  Point cohesion(const std::vector<const Boid*>&, double, const Config&);
 
   // implements alignment force on boid. see https://www.red3d.com/cwr/boids/
   // for more
@@ -78,8 +86,8 @@ class Boid : public Bird {
   using Bird::Bird;
 
   // updates position of boid. to do this it calls separation, cohesion,
-  // alignment and turn_around methods. if boid exceeds constants::max_velocity
-  // it slows down the boid.
+  // alignment and turn_around methods. if boid exceeds the max_velocity of
+  // the configuration it slows down the boid.
   // Param 1: delta_t, time step in the equation of motion, affecting the speed
   // of the object.
   // Param 2: vector containing the boids in the alignment/cohesion range
@@ -88,8 +96,9 @@ class Boid : public Bird {
   // Param 4: a coefficent to pass as parameter 3 of separation
   // Param 5: ge to pass as parameter 2 of cohesion
   // Param 6: ge to pass as parameter 2 of alignment
+  // Param 7: the configuration
   void update(double, const std::vector<const Boid*>&, double, double,
-                   double, double);
+                   double, double, const Config& = default_config);
 };
 
 }  // namespace boids
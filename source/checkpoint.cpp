@@ -0,0 +1,190 @@
+#include "checkpoint.hpp"
+
+#include <cstdint>
+#include <cstring>  //for std::memcmp
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "boid.hpp"
+#include "config.hpp"
+#include "constants.hpp"
+#include "parallel.hpp"
+#include "point.hpp"
+
+namespace boids {
+namespace {
+// throws std::runtime_error with the provided message if the condition is
+// false
+void require(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error{"checkpoint: " + message};
+  }
+}
+
+// rounds the offset up to the next multiple of constants::checkpoint_alignment
+std::uint64_t align(std::uint64_t offset) {
+  constexpr std::uint64_t alignment = constants::checkpoint_alignment;
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// places the four arrays of a flock of the provided size from the offset,
+// which is moved past them
+Flock_offsets place_flock(std::uint64_t count, std::uint64_t& offset) {
+  std::uint64_t size = align(count * sizeof(double));
+  Flock_offsets offsets;
+  offsets.x = offset;
+  offsets.y = offsets.x + size;
+  offsets.vel_x = offsets.y + size;
+  offsets.vel_y = offsets.vel_x + size;
+  offset = offsets.vel_y + size;
+  return offsets;
+}
+
+// writes zeros up to the offset
+void pad(std::ostream& output, std::uint64_t& position, std::uint64_t offset) {
+  static const char zeros[constants::checkpoint_alignment]{};
+  output.write(zeros, static_cast<std::streamsize>(offset - position));
+  position = offset;
+}
+
+// writes the four arrays of a flock, starting from the provided position
+template <class T>
+void write_flock(std::ostream& output, const std::vector<T>& bird_vec,
+                 const Flock_offsets& offsets, std::uint64_t& position) {
+  int size = static_cast<int>(bird_vec.size());
+  std::vector<double> array(bird_vec.size());
+  auto write_array = [&](std::uint64_t offset, auto coordinate) {
+    parallel_for(size, [&](int i) { array[i] = coordinate(bird_vec[i]); });
+    pad(output, position, offset);
+    output.write(reinterpret_cast<const char*>(array.data()),
+                 static_cast<std::streamsize>(array.size() * sizeof(double)));
+    position += array.size() * sizeof(double);
+  };
+  write_array(offsets.x, [](const T& bird) { return bird.pos().x(); });
+  write_array(offsets.y, [](const T& bird) { return bird.pos().y(); });
+  write_array(offsets.vel_x, [](const T& bird) { return bird.vel().x(); });
+  write_array(offsets.vel_y, [](const T& bird) { return bird.vel().y(); });
+}
+
+// reads an array of doubles of the provided size at the offset
+std::vector<double> read_array(std::istream& input, std::uint64_t offset,
+                               std::uint64_t count, std::uint64_t length) {
+  require(offset % constants::checkpoint_alignment == 0 &&
+              offset <= length &&
+              count <= (length - offset) / sizeof(double),
+          "array out of the file");
+  std::vector<double> array(count);
+  input.seekg(static_cast<std::streamoff>(offset));
+  input.read(reinterpret_cast<char*>(array.data()),
+             static_cast<std::streamsize>(count * sizeof(double)));
+  require(static_cast<bool>(input), "truncated array");
+  return array;
+}
+
+// reads the four arrays of a flock into the birds
+template <class T>
+std::vector<T> read_flock(std::istream& input, const Flock_offsets& offsets,
+                          std::uint64_t count, std::uint64_t length) {
+  require(count <= static_cast<std::uint64_t>(
+                       std::numeric_limits<int>::max()),
+          "too many birds");
+  auto x = read_array(input, offsets.x, count, length);
+  auto y = read_array(input, offsets.y, count, length);
+  auto vel_x = read_array(input, offsets.vel_x, count, length);
+  auto vel_y = read_array(input, offsets.vel_y, count, length);
+
+  std::vector<T> bird_vec(count);
+  parallel_for(static_cast<int>(count), [&](int i) {
+    bird_vec[i] = T{Point{x[i], y[i]}, Point{vel_x[i], vel_y[i]}};
+  });
+  return bird_vec;
+}
+
+// reads a text of the provided size
+std::string read_text(std::istream& input, std::uint64_t size,
+                      std::uint64_t length) {
+  require(size <= length, "text out of the file");
+  std::string text(size, '\0');
+  input.read(text.data(), static_cast<std::streamsize>(size));
+  require(static_cast<bool>(input), "truncated text");
+  return text;
+}
+}  // namespace
+
+void write_checkpoint(std::ostream& output, const Config& config,
+                      const Slider_values& sliders, std::uint64_t step,
+                      const std::mt19937& mt,
+                      const std::vector<Boid>& boid_vec,
+                      const std::vector<Predator>& predator_vec) {
+  std::ostringstream config_text;
+  config.write(config_text);
+  std::ostringstream engine_text;
+  engine_text << mt;
+
+  Checkpoint_header header;
+  header.step = step;
+  header.boid_count = boid_vec.size();
+  header.predator_count = predator_vec.size();
+  header.sliders = sliders;
+  header.config_size = config_text.str().size();
+  header.engine_size = engine_text.str().size();
+
+  std::uint64_t offset =
+      align(sizeof(header) + header.config_size + header.engine_size);
+  header.boids = place_flock(header.boid_count, offset);
+  header.predators = place_flock(header.predator_count, offset);
+
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output << config_text.str() << engine_text.str();
+  std::uint64_t position =
+      sizeof(header) + header.config_size + header.engine_size;
+  write_flock(output, boid_vec, header.boids, position);
+  write_flock(output, predator_vec, header.predators, position);
+  output.flush();
+  require(static_cast<bool>(output), "cannot write the file");
+}
+
+Checkpoint read_checkpoint(std::istream& input) {
+  // the length of the stream bounds every size read from the header
+  input.seekg(0, std::ios::end);
+  auto end = input.tellg();
+  require(end >= 0, "cannot read the file");
+  auto length = static_cast<std::uint64_t>(end);
+  input.seekg(0);
+
+  Checkpoint_header header;
+  const Checkpoint_header expected;
+  input.read(reinterpret_cast<char*>(&header), sizeof(header));
+  require(static_cast<bool>(input) &&
+              std::memcmp(header.magic, expected.magic,
+                          sizeof(header.magic)) == 0,
+          "not a checkpoint");
+  require(header.version == checkpoint_version, "unsupported version");
+  require(header.byte_order == expected.byte_order, "wrong byte order");
+
+  Checkpoint checkpoint;
+  std::istringstream config_text{
+      read_text(input, header.config_size, length)};
+  checkpoint.config.read(config_text);
+  checkpoint.config.validate();
+
+  std::istringstream engine_text{
+      read_text(input, header.engine_size, length)};
+  engine_text >> checkpoint.mt;
+  require(static_cast<bool>(engine_text), "invalid random engine");
+
+  checkpoint.sliders = header.sliders;
+  checkpoint.step = header.step;
+  checkpoint.boids =
+      read_flock<Boid>(input, header.boids, header.boid_count, length);
+  checkpoint.predators = read_flock<Predator>(input, header.predators,
+                                              header.predator_count, length);
+  return checkpoint;
+}
+}  // namespace boids
@@ -0,0 +1,94 @@
+// binary checkpoints of a simulation, to resume long runs and to start
+// benchmarks from a known state. a checkpoint file is made of:
+// - a fixed size Checkpoint_header;
+// - the configuration, as the text written by Config::write;
+// - the state of the random engine, as written by operator<<;
+// - the positions and velocities of the boids and of the predators, as
+//   structures of arrays of doubles (x, y, velocity x, velocity y).
+// each array starts at a multiple of constants::checkpoint_alignment bytes,
+// at the offset stored in the header, so a reader mapping the file in memory
+// can use the arrays in place. numbers are stored in the byte order of the
+// machine that wrote them, which is recorded in the header.
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
+
+#include "boid.hpp"
+#include "config.hpp"
+
+namespace boids {
+
+// current version of the format, increased at every incompatible change
+inline constexpr std::uint32_t checkpoint_version{1};
+
+// the values of the sliders of the panel
+struct Slider_values {
+  double cohesion_coefficent{};
+  double alignment_coefficent{};
+  double separation_coefficent{};
+  double range{};
+  double separation_range{};
+  double prey_range{};
+};
+
+// offsets, from the start of the file, of the arrays of a flock
+struct Flock_offsets {
+  std::uint64_t x{};
+  std::uint64_t y{};
+  std::uint64_t vel_x{};
+  std::uint64_t vel_y{};
+};
+
+struct Checkpoint_header {
+  char magic[8]{'B', 'O', 'I', 'D', 'C', 'K', 'P', 'T'};
+  std::uint32_t version{checkpoint_version};
+  // 0x01020304 as written, to detect files from machines with another order
+  std::uint32_t byte_order{0x01020304};
+  std::uint64_t step{};
+  std::uint64_t boid_count{};
+  std::uint64_t predator_count{};
+  Slider_values sliders{};
+  // sizes of the texts of the configuration and of the random engine, which
+  // follow the header
+  std::uint64_t config_size{};
+  std::uint64_t engine_size{};
+  Flock_offsets boids{};
+  Flock_offsets predators{};
+};
+
+// a simulation read from a checkpoint
+struct Checkpoint {
+  Config config{};
+  Slider_values sliders{};
+  std::uint64_t step{};
+  std::mt19937 mt{};
+  std::vector<Boid> boids;
+  std::vector<Predator> predators;
+};
+
+// writes a checkpoint of the simulation to the stream, which should be
+// opened in binary mode. throws std::runtime_error if writing fails
+// Param 1: the stream
+// Param 2: the configuration
+// Param 3: the values of the sliders
+// Param 4: number of steps done
+// Param 5: the random engine
+// Param 6: vector of boids
+// Param 7: vector of predators
+void write_checkpoint(std::ostream&, const Config&, const Slider_values&,
+                      std::uint64_t, const std::mt19937&,
+                      const std::vector<Boid>&, const std::vector<Predator>&);
+
+// reads a checkpoint written by write_checkpoint from the stream, which
+// should be opened in binary mode. throws std::runtime_error if the stream
+// is not a checkpoint of this version or is truncated, and
+// std::invalid_argument if its configuration is invalid
+// Param 1: the stream
+Checkpoint read_checkpoint(std::istream&);
+}  // namespace boids
+#endif
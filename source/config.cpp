@@ -0,0 +1,294 @@
+#include "config.hpp"
+
+#include <algorithm>  //for std::min
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "constants.hpp"
+
+namespace boids {
+namespace {
+// returns the text without leading and trailing spaces
+std::string trim(const std::string& text) {
+  auto first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  auto last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+// the read functions throw std::invalid_argument if the whole text is not a
+// value of their type
+double read_double(const std::string& name, const std::string& text) {
+  std::size_t length{};
+  double value{};
+  try {
+    value = std::stod(text, &length);
+  } catch (const std::exception&) {
+    length = 0;
+  }
+  if (length == 0 || length != text.size()) {
+    throw std::invalid_argument{"invalid value of " + name + ": " + text};
+  }
+  return value;
+}
+
+int read_int(const std::string& name, const std::string& text) {
+  std::size_t length{};
+  int value{};
+  try {
+    value = std::stoi(text, &length);
+  } catch (const std::exception&) {
+    length = 0;
+  }
+  if (length == 0 || length != text.size()) {
+    throw std::invalid_argument{"invalid value of " + name + ": " + text};
+  }
+  return value;
+}
+
+bool read_bool(const std::string& name, const std::string& text) {
+  if (text == "true" || text == "1") {
+    return true;
+  }
+  if (text == "false" || text == "0") {
+    return false;
+  }
+  throw std::invalid_argument{"invalid value of " + name + ": " + text};
+}
+
+constants::Spatial_index read_spatial_index(const std::string& name,
+                                            const std::string& text) {
+  if (text == "quad_tree") {
+    return constants::Spatial_index::quad_tree;
+  }
+  if (text == "linear_quad_tree") {
+    return constants::Spatial_index::linear_quad_tree;
+  }
+  if (text == "kd_tree") {
+    return constants::Spatial_index::kd_tree;
+  }
+  throw std::invalid_argument{"invalid value of " + name + ": " + text};
+}
+
+const char* spatial_index_name(constants::Spatial_index spatial_index) {
+  switch (spatial_index) {
+    case constants::Spatial_index::quad_tree:
+      return "quad_tree";
+    case constants::Spatial_index::linear_quad_tree:
+      return "linear_quad_tree";
+    case constants::Spatial_index::kd_tree:
+      return "kd_tree";
+  }
+  return "";
+}
+
+// throws std::invalid_argument with the provided message if the condition
+// is false
+void require(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::invalid_argument{message};
+  }
+}
+
+// reads a name=value pair into the configuration
+void set_pair(Config& config, const std::string& pair) {
+  auto equal = pair.find('=');
+  if (equal == std::string::npos) {
+    throw std::invalid_argument{"expected name=value: " + pair};
+  }
+  config.set(trim(pair.substr(0, equal)), trim(pair.substr(equal + 1)));
+}
+}  // namespace
+
+void Config::set(const std::string& name, const std::string& value) {
+  if (name == "world_width") {
+    world.width = read_double(name, value);
+  } else if (name == "world_height") {
+    world.height = read_double(name, value);
+  } else if (name == "toroidal_world") {
+    world.toroidal = read_bool(name, value);
+  } else if (name == "max_velocity") {
+    max_velocity = read_double(name, value);
+  } else if (name == "velocity_reduction_coefficent") {
+    velocity_reduction_coefficent = read_double(name, value);
+  } else if (name == "turn_coefficent") {
+    turn_coefficent = read_double(name, value);
+  } else if (name == "margin_size") {
+    margin_size = read_double(name, value);
+  } else if (name == "repel_coefficent") {
+    repel_coefficent = read_double(name, value);
+  } else if (name == "repel_range") {
+    repel_range = read_double(name, value);
+  } else if (name == "predator_avoidance_coeff") {
+    predator_avoidance_coeff = read_double(name, value);
+  } else if (name == "predator_hunting_coeff") {
+    predator_hunting_coeff = read_double(name, value);
+  } else if (name == "prey_to_predator_coeff") {
+    prey_to_predator_coeff = read_double(name, value);
+  } else if (name == "delta_t_boid") {
+    delta_t_boid = read_double(name, value);
+  } else if (name == "delta_t_predator") {
+    delta_t_predator = read_double(name, value);
+  } else if (name == "max_boid_number") {
+    max_boid_number = read_int(name, value);
+  } else if (name == "max_predator_number") {
+    max_predator_number = read_int(name, value);
+  } else if (name == "spatial_index") {
+    spatial_index = read_spatial_index(name, value);
+  } else if (name == "cell_capacity") {
+    cell_capacity = read_int(name, value);
+  } else if (name == "min_cell_capacity") {
+    min_cell_capacity = read_int(name, value);
+  } else if (name == "max_cell_capacity") {
+    max_cell_capacity = read_int(name, value);
+  } else if (name == "capacity_step") {
+    capacity_step = read_int(name, value);
+  } else if (name == "tuner_sample_frames") {
+    tuner_sample_frames = read_int(name, value);
+  } else if (name == "topological_neighbours") {
+    topological_neighbours = read_int(name, value);
+  } else if (name == "max_neighbours") {
+    max_neighbours = read_int(name, value);
+  } else if (name == "spatial_sort_period") {
+    spatial_sort_period = read_int(name, value);
+  } else if (name == "verlet_skin") {
+    verlet_skin = read_double(name, value);
+  } else if (name == "simulation_rate") {
+    simulation_rate = read_double(name, value);
+  } else if (name == "record_period") {
+    record_period = read_int(name, value);
+  } else if (name == "export_frames") {
+    export_frames = read_int(name, value);
+  } else if (name == "raw_video") {
+    raw_video = read_bool(name, value);
+  } else if (name == "vertex_buffer") {
+    vertex_buffer = read_bool(name, value);
+  } else if (name == "interpolation") {
+    interpolation = read_bool(name, value);
+  } else {
+    throw std::invalid_argument{"unknown setting: " + name};
+  }
+}
+
+void Config::read(std::istream& input) {
+  std::string line;
+  while (std::getline(input, line)) {
+    line = trim(line);
+    if (!line.empty() && line[0] != '#') {
+      set_pair(*this, line);
+    }
+  }
+}
+
+void Config::write(std::ostream& output) const {
+  // enough digits to read back the same doubles
+  auto precision =
+      output.precision(std::numeric_limits<double>::max_digits10);
+  output << "world_width=" << world.width << '\n'
+         << "world_height=" << world.height << '\n'
+         << "toroidal_world=" << (world.toroidal ? "true" : "false") << '\n'
+         << "max_velocity=" << max_velocity << '\n'
+         << "velocity_reduction_coefficent=" << velocity_reduction_coefficent
+         << '\n'
+         << "turn_coefficent=" << turn_coefficent << '\n'
+         << "margin_size=" << margin_size << '\n'
+         << "repel_coefficent=" << repel_coefficent << '\n'
+         << "repel_range=" << repel_range << '\n'
+         << "predator_avoidance_coeff=" << predator_avoidance_coeff << '\n'
+         << "predator_hunting_coeff=" << predator_hunting_coeff << '\n'
+         << "prey_to_predator_coeff=" << prey_to_predator_coeff << '\n'
+         << "delta_t_boid=" << delta_t_boid << '\n'
+         << "delta_t_predator=" << delta_t_predator << '\n'
+         << "max_boid_number=" << max_boid_number << '\n'
+         << "max_predator_number=" << max_predator_number << '\n'
+         << "spatial_index=" << spatial_index_name(spatial_index) << '\n'
+         << "cell_capacity=" << cell_capacity << '\n'
+         << "min_cell_capacity=" << min_cell_capacity << '\n'
+         << "max_cell_capacity=" << max_cell_capacity << '\n'
+         << "capacity_step=" << capacity_step << '\n'
+         << "tuner_sample_frames=" << tuner_sample_frames << '\n'
+         << "topological_neighbours=" << topological_neighbours << '\n'
+         << "max_neighbours=" << max_neighbours << '\n'
+         << "spatial_sort_period=" << spatial_sort_period << '\n'
+         << "verlet_skin=" << verlet_skin << '\n'
+         << "simulation_rate=" << simulation_rate << '\n'
+         << "record_period=" << record_period << '\n'
+         << "export_frames=" << export_frames << '\n'
+         << "raw_video=" << (raw_video ? "true" : "false") << '\n'
+         << "vertex_buffer=" << (vertex_buffer ? "true" : "false") << '\n'
+         << "interpolation=" << (interpolation ? "true" : "false") << '\n';
+  output.precision(precision);
+}
+
+void Config::validate() const {
+  require(world.width > 2. * margin_size && world.height > 2. * margin_size,
+          "the world must be larger than its margins");
+  require(margin_size >= 0., "margin_size must not be negative");
+  require(max_velocity > 0., "max_velocity must be positive");
+  require(velocity_reduction_coefficent > 0. &&
+              velocity_reduction_coefficent <= 1.,
+          "velocity_reduction_coefficent must be in (0, 1]");
+  require(turn_coefficent >= 0. && repel_coefficent >= 0. &&
+              predator_avoidance_coeff >= 0. && predator_hunting_coeff >= 0.,
+          "the coefficents must not be negative");
+  require(repel_range >= 0. && prey_to_predator_coeff >= 0.,
+          "the ranges must not be negative");
+  require(delta_t_boid >= 0. && delta_t_predator >= 0.,
+          "the time steps must not be negative");
+  require(max_boid_number >= 0 && max_predator_number >= 0,
+          "the numbers of birds must not be negative");
+  require(min_cell_capacity > 0 && min_cell_capacity <= cell_capacity &&
+              cell_capacity <= max_cell_capacity,
+          "the cell capacities must satisfy 0 < min_cell_capacity <= "
+          "cell_capacity <= max_cell_capacity");
+  require(capacity_step > 0 && tuner_sample_frames > 0,
+          "capacity_step and tuner_sample_frames must be positive");
+  require(topological_neighbours >= 0 && max_neighbours >= 0,
+          "the numbers of neighbours must not be negative");
+  require(spatial_sort_period >= 0, "spatial_sort_period must not be negative");
+  require(verlet_skin >= 0., "verlet_skin must not be negative");
+  require(simulation_rate >= 0., "simulation_rate must not be negative");
+  require(record_period >= 0, "record_period must not be negative");
+  require(export_frames > 0, "export_frames must be positive");
+
+  // the periodic images are only valid for ranges below half the world
+  require(!world.toroidal ||
+              2. * (constants::max_range + verlet_skin) <=
+                  std::min(world.width, world.height),
+          "a toroidal world must be larger than twice the range plus the skin");
+}
+
+bool read_arguments(int argc, char* argv[], Config& config) {
+  int sizes{0};
+  for (int i = 1; i < argc; ++i) {
+    std::string argument{argv[i]};
+    if (argument == "--config") {
+      require(i + 1 < argc, "--config needs a file");
+      std::ifstream file{argv[++i]};
+      require(static_cast<bool>(file),
+              std::string{"cannot open "} + argv[i]);
+      config.read(file);
+    } else if (argument.find('=') != std::string::npos) {
+      set_pair(config, argument);
+    } else {
+      // plain numbers are the width and the height of the world
+      require(sizes < 2, "unexpected argument: " + argument);
+      double size = read_double("the world size", argument);
+      if (sizes == 0) {
+        config.world.width = size;
+        config.world.height = size;
+      } else {
+        config.world.height = size;
+      }
+      ++sizes;
+    }
+  }
+  return argc > 1;
+}
+}  // namespace boids
@@ -0,0 +1,117 @@
+// settings of the simulation that can be changed without rebuilding. their
+// defaults are the values in constants.hpp, a configuration file or the
+// command line can override them with lines/arguments of the form
+// name=value, using the names of the members of Config.
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "constants.hpp"
+#include "world.hpp"
+
+namespace boids {
+struct Config {
+  // the area where the birds fly. set with world_width, world_height and
+  // toroidal_world
+  World world{window_world};
+
+  // birds
+  double max_velocity{constants::max_velocity};
+  double velocity_reduction_coefficent{
+      constants::velocity_reduction_coefficent};
+  double turn_coefficent{constants::turn_coefficent};
+  double margin_size{constants::margin_size};
+  double repel_coefficent{constants::repel_coefficent};
+  double repel_range{constants::repel_range};
+  double predator_avoidance_coeff{constants::predator_avoidance_coeff};
+  double predator_hunting_coeff{constants::predator_hunting_coeff};
+  double prey_to_predator_coeff{constants::prey_to_predator_coeff};
+  double delta_t_boid{constants::delta_t_boid};
+  double delta_t_predator{constants::delta_t_predator};
+  int max_boid_number{constants::max_boid_number};
+  int max_predator_number{constants::max_predator_number};
+
+  // spatial index
+  constants::Spatial_index spatial_index{constants::spatial_index};
+  int cell_capacity{constants::cell_capacity};
+  int min_cell_capacity{constants::min_cell_capacity};
+  int max_cell_capacity{constants::max_cell_capacity};
+  int capacity_step{constants::capacity_step};
+  int tuner_sample_frames{constants::tuner_sample_frames};
+  int topological_neighbours{constants::topological_neighbours};
+  int max_neighbours{constants::max_neighbours};
+  int spatial_sort_period{constants::spatial_sort_period};
+  double verlet_skin{constants::verlet_skin};
+
+  // steps per second, 0 for as fast as possible
+  double simulation_rate{constants::simulation_rate};
+
+  // recording, see recording.hpp
+  int record_period{constants::record_period};
+
+  // export, see frame_export.hpp
+  int export_frames{constants::export_frames};
+  bool raw_video{constants::raw_video};
+
+  // rendering
+  bool vertex_buffer{constants::vertex_buffer};
+  bool interpolation{constants::interpolation};
+
+  // sets the setting with the provided name. throws std::invalid_argument if
+  // there is no such setting or the value cannot be read
+  // Param 1: name of the setting
+  // Param 2: the value, as text
+  void set(const std::string&, const std::string&);
+
+  // reads name=value lines from the stream. empty lines and lines starting
+  // with # are skipped. throws std::invalid_argument on malformed lines
+  // Param 1: the stream
+  void read(std::istream&);
+
+  // writes every setting as a name=value line, so that read() gives back the
+  // same configuration
+  // Param 1: the stream
+  void write(std::ostream&) const;
+
+  // throws std::invalid_argument if the settings are out of their bounds or
+  // inconsistent with each other
+  void validate() const;
+};
+
+// the configuration given by constants.hpp
+inline constexpr Config default_config{};
+
+// reads the command line into the configuration: "--config file" reads a
+// configuration file, "name=value" sets a single setting and up to two plain
+// numbers set the width and height of the world. returns false if there
+// were no arguments, so the configuration is still default_config. throws
+// std::invalid_argument on invalid arguments.
+// Param 1: number of arguments
+// Param 2: the arguments
+// Param 3: the configuration
+bool read_arguments(int, char*[], Config&);
+
+// access to the configuration from the templates of the simulation loop.
+// Fixed_config always gives default_config, known at compile time, so the
+// compiler can fold the settings read by the step itself, e.g. the choice of
+// the spatial index and of the neighbourhood. the birds are updated out of
+// line and read their settings at run time in any case.
+// Runtime_config gives a configuration read at run time.
+struct Fixed_config {
+  static constexpr const Config& get() { return default_config; }
+};
+
+class Runtime_config {
+  const Config& m_config;
+
+ public:
+  // Param 1: m_config
+  explicit Runtime_config(const Config& config) : m_config{config} {}
+
+  const Config& get() const { return m_config; }
+};
+}  // namespace boids
+#endif
@@ -2,7 +2,10 @@
 #define CONSTANTS_HPP
 
 #include <SFML/Graphics.hpp>
+#include <cstddef>  //for std::size_t
 
+// many of the values below are only defaults, that can be changed at run time
+// through boids::Config (see config.hpp)
 namespace constants {
 
 // window constants ////////////////////////////////////////////////////////
@@ -17,6 +20,33 @@ inline constexpr double margin_size{20.};
 
 // width of the space dedicated to sliders and buttons
 inline constexpr double controls_width{230.};
+
+// if true, birds leaving the window from one side reenter from the opposite
+// one, instead of being pushed back from the margins, and see the birds
+// across the edges. the range must stay below half of the window
+inline constexpr bool toroidal_world{false};
+
+// if true, the birds are drawn from a vertex buffer in the memory of the
+// graphics card, streamed at every frame. drivers without vertex buffers
+// fall back to drawing the vertex arrays
+inline constexpr bool vertex_buffer{true};
+
+// steps per second of the simulation, which runs on its own thread. the
+// window shows the last completed step, at most 60 times per second. every
+// step advances the birds by delta_t_boid/delta_t_predator, so the flock
+// keeps the same speed whatever the frame rate. 0 runs the simulation as
+// fast as possible
+inline constexpr double simulation_rate{60.};
+
+// steps run back to back by a simulation that fell behind its rate. the
+// time lost beyond them is dropped: the flock slows down, rather than
+// falling further and further behind
+inline constexpr int max_catch_up_steps{5};
+
+// if true, the window draws the birds between their positions of the last
+// two steps, according to the time elapsed since the last one, so they move
+// smoothly whatever the simulation rate
+inline constexpr bool interpolation{true};
 ////////////////////////////////////////////////////////////////////////////
 
 // birds constants /////////////////////////////////////////////////////////
@@ -28,6 +58,11 @@ inline constexpr double max_alignment_strength{0.2};
 inline constexpr int max_boid_number{300};
 inline constexpr int max_predator_number{10};
 
+// memory the simulation may use per boid, in bytes: the boid and its handle,
+// the spatial index and the neighbour lists, with about ten boids in range,
+// and the buffers of the frames and the window
+inline constexpr std::size_t memory_per_boid_budget{576};
+
 inline constexpr double max_range{40.};
 inline constexpr double max_separation_range{15.};
 inline constexpr double max_prey_range{60.};
@@ -96,6 +131,26 @@ inline const sf::Color prey_range_color{sf::Color::Red};
 
 // thickness of displayed ranges
 inline const double range_thickness{1.}; 
+
+// the mouse wheel zooms the camera by this factor
+inline constexpr double camera_zoom_factor{1.25};
+// the arrow keys move the camera by this fraction of the visible area
+inline constexpr double camera_pan_fraction{0.1};
+
+// seconds between two updates of the statistics label, which is meant to be
+// read, not to follow every step
+inline constexpr double stats_refresh_period{0.25};
+////////////////////////////////////////////////////////////////////////////
+
+// level of detail constants, see lod.hpp //////////////////////////////////
+// birds are drawn as triangles while their size covers at least this many
+// pixels, as points or densities otherwise
+inline constexpr double triangle_min_pixels{2.};
+// side of the cells of the density grid, in pixels
+inline constexpr double density_cell_pixels{4.};
+// opacity of the cells holding a single bird. the most crowded cell is
+// opaque, the others in between, on a logarithmic scale
+inline constexpr double density_min_alpha{64.};
 ////////////////////////////////////////////////////////////////////////////
 
 // initial values //////////////////////////////////////////////////////////
@@ -116,14 +171,104 @@ inline constexpr int init_predator_number{0};
 ////////////////////////////////////////////////////////////////////////////
 
 // quad_tree constants /////////////////////////////////////////////////////
-// capacity of quad_tree cell, subdivides if excedeed
+// spatial index used to find the boids in range
+enum class Spatial_index { quad_tree, linear_quad_tree, kd_tree };
+inline constexpr Spatial_index spatial_index{Spatial_index::linear_quad_tree};
+
+// capacity of quad_tree cell, subdivides if excedeed.
+// it is the initial value, the capacity then gets tuned at run time
+// between min_cell_capacity and max_cell_capacity
 inline constexpr int cell_capacity{10};
+inline constexpr int min_cell_capacity{2};
+inline constexpr int max_cell_capacity{64};
+
+// the capacity is changed by this amount each time it gets tuned
+inline constexpr int capacity_step{2};
+
+// number of frames whose cost is averaged before tuning the capacity
+inline constexpr int tuner_sample_frames{30};
+
+// number of closest boids each boid interacts with (topological
+// neighbourhood, as observed in starling flocks). 0 means each boid interacts
+// with all the boids within range (metric neighbourhood)
+inline constexpr int topological_neighbours{0};
+
+// maximum number of boids within range each boid interacts with, so the
+// cost of a boid stays bounded when the flock gets dense. 0 means no limit
+inline constexpr int max_neighbours{0};
 
-// color of cells diplayed with display_tree
-inline constexpr double displayed_cell_thickness{1.};
+// every this many steps the boids get sorted by morton code, to keep close
+// boids close in memory. 0 disables the sorting
+inline constexpr int spatial_sort_period{100};
+
+// maximum number of subdivisions of the quad tree. cells at this depth
+// accept any number of boids
+inline constexpr int max_tree_depth{10};
+
+// extra distance of the verlet neighbour lists. lists hold the boids within
+// range + skin and get rebuilt once some boid has moved more than skin / 2,
+// so boids flying at max_velocity keep them for a couple of steps. 0 queries
+// the spatial index at every step. ignored in topological mode
+inline constexpr double verlet_skin{12.};
+
+// color of cells diplayed with display_tree. their edges are drawn as one
+// pixel wide lines
 inline const sf::Color tree_color{sf::Color::Green};
 ////////////////////////////////////////////////////////////////////////////
 
+// parallelism constants ///////////////////////////////////////////////////
+// loops over fewer elements than this run on a single thread
+inline constexpr int min_parallel_size{4096};
+// new birds are generated in blocks of this many, each drawing from its own
+// random stream, so the same seed gives the same birds whatever the number
+// of threads
+inline constexpr int spawn_block_size{4096};
+// blocks of parameters the window can send ahead of the simulation. when
+// the queue is full the window sends the latest values once there is room
+inline constexpr std::size_t parameter_queue_size{16};
+////////////////////////////////////////////////////////////////////////////
+
+// checkpoint constants ///////////////////////////////////////////////////
+// file written when the checkpoint key is pressed
+inline constexpr const char* checkpoint_file{"boids.checkpoint"};
+// the arrays of a checkpoint start at multiples of this many bytes, so they
+// can be used in place once the file is mapped in memory
+inline constexpr int checkpoint_alignment{64};
+////////////////////////////////////////////////////////////////////////////
+
+// recording constants ////////////////////////////////////////////////////
+// file written when the simulation is recorded, see Config::record_period
+inline constexpr const char* recording_file{"boids.recording"};
+// steps between recorded frames, 0 to record nothing
+inline constexpr int record_period{0};
+// positions and velocities are recorded as integer multiples of these
+inline constexpr double position_quantum{1. / 64.};
+inline constexpr double velocity_quantum{1. / 1024.};
+// maximum number of frames in a chunk of a recording. chunks are written
+// whole, and a chunk cut short by a crash is skipped
+inline constexpr int recording_chunk_frames{32};
+// every this many frames of a chunk, a keyframe is stored whole rather than
+// as differences, and its offset is in the header of the chunk: a frame is
+// decoded from the last keyframe before it, so seeking decodes at most this
+// many frames
+inline constexpr int recording_keyframe_period{8};
+// maximum number of frames waiting to be written. frames recorded while the
+// queue is full get dropped, so a slow disk never stalls the simulation
+inline constexpr int recorder_queue_size{4};
+////////////////////////////////////////////////////////////////////////////
+
+// export constants, see frame_export.hpp //////////////////////////////////
+// number of frames written by boid --export
+inline constexpr int export_frames{600};
+// if true the frames are written as raw pixels in export_raw_file, rather
+// than as PNG files
+inline constexpr bool raw_video{false};
+inline constexpr const char* export_raw_file{"frames.rgba"};
+// maximum number of frames waiting to be written. drawing waits for room,
+// the simulation does not
+inline constexpr int export_queue_size{8};
+////////////////////////////////////////////////////////////////////////////
+
 // statisitcs constants ////////////////////////////////////////////////////
 // coefficent for sample size in approx distance.
 // todo: delete if unused
@@ -133,6 +278,10 @@ inline constexpr int max_statistics_boid_number{300};
 
 // math constants //////////////////////////////////////////////////////////
 inline constexpr double pi = 3.14159265358979;
+// cosine and sine of 120 degrees, the angle between the vertices of the
+// triangles of the birds
+inline constexpr double cos_120{-0.5};
+inline constexpr double sin_120{0.866025403784438647};
 ////////////////////////////////////////////////////////////////////////////
 }  // namespace constants
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "frame_export.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>  //for std::size_t
+#include <filesystem>
+#include <iomanip>  //for std::setw
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>  //for std::move
+
+#include "constants.hpp"
+
+namespace boids {
+namespace {
+// throws std::runtime_error with the provided message if the condition is
+// false
+void require(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error{"export: " + message};
+  }
+}
+}  // namespace
+
+Frame_writer::Frame_writer(const std::string& directory, bool raw)
+    : m_directory{directory}, m_raw{raw} {
+  require(std::filesystem::is_directory(directory),
+          directory + " is not a directory");
+  if (raw) {
+    std::string path = directory + '/' + constants::export_raw_file;
+    m_video.open(path, std::ios::binary | std::ios::trunc);
+    require(static_cast<bool>(m_video), "cannot create " + path);
+  }
+  m_writer = std::thread{[this] { write_frames(); }};
+}
+
+Frame_writer::~Frame_writer() { close(); }
+
+void Frame_writer::write(sf::Image frame) {
+  {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_condition.wait(lock, [this] {
+      return static_cast<int>(m_queue.size()) < constants::export_queue_size;
+    });
+    m_queue.push_back(std::move(frame));
+  }
+  m_condition.notify_all();
+}
+
+void Frame_writer::write_frames() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+  while (true) {
+    m_condition.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+    if (m_queue.empty()) {
+      return;
+    }
+    // the frame stays queued while it is written, so the queue never holds
+    // more than export_queue_size frames
+    const sf::Image& frame = m_queue.front();
+    bool failed = m_failed;
+    int number = m_written;
+
+    lock.unlock();
+    bool written = !failed && write_frame(frame, number);
+    lock.lock();
+
+    m_failed = !written;
+    if (written) {
+      ++m_written;
+    }
+    m_queue.pop_front();
+    m_condition.notify_all();
+  }
+}
+
+bool Frame_writer::write_frame(const sf::Image& frame, int number) {
+  if (m_raw) {
+    auto size = frame.getSize();
+    m_video.write(reinterpret_cast<const char*>(frame.getPixelsPtr()),
+                  static_cast<std::streamsize>(std::size_t{4} * size.x *
+                                               size.y));
+    return static_cast<bool>(m_video);
+  }
+
+  std::ostringstream path;
+  path << m_directory << "/frame_" << std::setfill('0') << std::setw(6)
+       << number << ".png";
+  return frame.saveToFile(path.str());
+}
+
+bool Frame_writer::close() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_closing = true;
+  }
+  m_condition.notify_all();
+
+  if (m_writer.joinable()) {
+    m_writer.join();
+    if (m_raw) {
+      m_video.close();
+      m_failed = m_failed || !m_video;
+    }
+  }
+  return !m_failed;
+}
+
+int Frame_writer::written() {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_written;
+}
+}  // namespace boids
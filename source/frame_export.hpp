@@ -0,0 +1,74 @@
+// export of the frames drawn by boid --export, for videos of runs on
+// machines without a display. frames are written either as numbered PNG
+// files, frame_000000.png, frame_000001.png..., or one after the other in a
+// single file of raw pixels, constants::export_raw_file: every frame is
+// width * height pixels, row by row from the top, four bytes (red, green,
+// blue, alpha) per pixel, e.g. for ffmpeg -f rawvideo -pix_fmt rgba.
+#ifndef FRAME_EXPORT_HPP
+#define FRAME_EXPORT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace boids {
+
+// writes the frames on a background thread: encoding and writing a frame
+// overlap with drawing and copying the next ones.
+class Frame_writer {
+  std::string m_directory;
+  bool m_raw{};
+  std::ofstream m_video;
+
+  // frames waiting to be written
+  std::deque<sf::Image> m_queue;
+  bool m_closing{false};
+  bool m_failed{false};
+  int m_written{0};
+  std::mutex m_mutex;
+  // signals both new frames, to the writer thread, and written ones, to the
+  // threads waiting for room in the queue
+  std::condition_variable m_condition;
+
+  std::thread m_writer;
+
+  // writes the queued frames until the writer is closed
+  void write_frames();
+
+  // writes a frame. returns false if writing failed
+  // Param 1: the frame
+  // Param 2: its number
+  bool write_frame(const sf::Image&, int);
+
+ public:
+  // starts the writer thread. throws std::runtime_error if the directory
+  // does not exist or the raw file cannot be created
+  // Param 1: the directory of the files
+  // Param 2: true to write raw pixels, false for PNG files
+  Frame_writer(const std::string&, bool);
+
+  // writes the queued frames
+  ~Frame_writer();
+
+  Frame_writer(const Frame_writer&) = delete;
+  Frame_writer& operator=(const Frame_writer&) = delete;
+
+  // queues a frame. waits while constants::export_queue_size frames are
+  // already queued, so a slow disk slows the export down but never fills
+  // the memory
+  // Param 1: the frame
+  void write(sf::Image);
+
+  // writes the queued frames and closes the files. returns false if writing
+  // failed at some point
+  bool close();
+
+  // returns the number of frames written so far
+  int written();
+};
+}  // namespace boids
+#endif
@@ -1,8 +1,12 @@
 #include "gui.hpp"
 
+#include <cmath>  //for std::lround
 #include <memory>
+#include <string>
 
 #include "boid.hpp"
+#include "checkpoint.hpp"
+#include "config.hpp"
 #include "constants.hpp"
 #include "sfml.hpp"
 namespace boids {
@@ -26,7 +30,13 @@ void Panel::insert(tgui::Widget::Ptr widget, widget_key key) {
 
 void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
                       bool& display_range, bool& display_separation_range,
-                      bool& display_prey_range) {
+                      bool& display_prey_range, Panel_values& values,
+                      const Config& config) {
+  values.sliders = initial_slider_values();
+  values.boid_number = constants::init_boid_number;
+  values.predator_number = constants::init_predator_number;
+  values.changed = true;
+
   tgui::Label::Ptr fps_text = tgui::Label::create();
   fps_text->getRenderer()->setTextColor(sf::Color::White);
   gui.add(fps_text);
@@ -46,6 +56,13 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr cohesion_strength_slider = tgui::Slider::create();
   cohesion_strength_slider->setValue(constants::init_cohesion_strength);
+  // the 0.1 coefficent is needed because the max value of sliders by deafult
+  // is 10, so multiplyng it 0.1 rescales it to 1
+  cohesion_strength_slider->onValueChange([&values](float value) {
+    values.sliders.cohesion_coefficent =
+        constants::max_cohesion_strength * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(cohesion_strength_slider);
   panel.insert(cohesion_strength_slider, widget_key::cohesion_strength_slider);
 
@@ -57,6 +74,11 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr aligment_strength_slider = tgui::Slider::create();
   aligment_strength_slider->setValue(constants::init_alignment_strength);
+  aligment_strength_slider->onValueChange([&values](float value) {
+    values.sliders.alignment_coefficent =
+        constants::max_alignment_strength * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(aligment_strength_slider);
   panel.insert(aligment_strength_slider, widget_key::alignment_strength_slider);
 
@@ -68,19 +90,31 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr separation_strength_slider = tgui::Slider::create();
   separation_strength_slider->setValue(constants::init_separation_strength);
+  separation_strength_slider->onValueChange([&values](float value) {
+    values.sliders.separation_coefficent =
+        constants::max_separation_strength * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(separation_strength_slider);
   panel.insert(separation_strength_slider,
                widget_key::separation_strength_slider);
 
   tgui::Label::Ptr boid_number_text = tgui::Label::create();
-  boid_number_text->setText("Number of Boids");
+  boid_number_text->setText("Number of Boids: " +
+                            std::to_string(values.boid_number));
   boid_number_text->getRenderer()->setTextColor(sf::Color::White);
   gui.add(boid_number_text);
   panel.insert(boid_number_text, widget_key::boid_number_text);
 
   tgui::Slider::Ptr boid_number_slider = tgui::Slider::create();
-  boid_number_slider->setMaximum(constants::max_boid_number);
+  boid_number_slider->setMaximum(config.max_boid_number);
   boid_number_slider->setValue(constants::init_boid_number);
+  boid_number_slider->onValueChange([&values, boid_number_text](float value) {
+    values.boid_number = static_cast<int>(value);
+    values.changed = true;
+    boid_number_text->setText("Number of Boids: " +
+                              std::to_string(values.boid_number));
+  });
   gui.add(boid_number_slider);
   panel.insert(boid_number_slider, widget_key::boid_number_slider);
 
@@ -92,6 +126,10 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr range_slider = tgui::Slider::create();
   range_slider->setValue(constants::init_range);
+  range_slider->onValueChange([&values](float value) {
+    values.sliders.range = constants::max_range * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(range_slider);
   panel.insert(range_slider, widget_key::range_slider);
 
@@ -109,6 +147,11 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr separation_range_slider = tgui::Slider::create();
   separation_range_slider->setValue(constants::init_separation_range);
+  separation_range_slider->onValueChange([&values](float value) {
+    values.sliders.separation_range =
+        constants::max_separation_range * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(separation_range_slider);
   panel.insert(separation_range_slider, widget_key::separation_range_slider);
 
@@ -121,14 +164,22 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
   panel.insert(separation_range_button, widget_key::separation_range_button);
 
   tgui::Label::Ptr predator_number_text = tgui::Label::create();
-  predator_number_text->setText("Number of Predators");
+  predator_number_text->setText("Number of Predators: " +
+                                std::to_string(values.predator_number));
   predator_number_text->getRenderer()->setTextColor(sf::Color::White);
   gui.add(predator_number_text);
   panel.insert(predator_number_text, widget_key::predator_number_text);
 
   tgui::Slider::Ptr predator_number_slider = tgui::Slider::create();
   predator_number_slider->setValue(constants::init_predator_number);
-  predator_number_slider->setMaximum(constants::max_predator_number);
+  predator_number_slider->setMaximum(config.max_predator_number);
+  predator_number_slider->onValueChange(
+      [&values, predator_number_text](float value) {
+        values.predator_number = static_cast<int>(value);
+        values.changed = true;
+        predator_number_text->setText("Number of Predators: " +
+                                      std::to_string(values.predator_number));
+      });
   gui.add(predator_number_slider);
   panel.insert(predator_number_slider, widget_key::predator_number_slider);
 
@@ -140,6 +191,10 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
 
   tgui::Slider::Ptr prey_range_slider = tgui::Slider::create();
   prey_range_slider->setValue(constants::init_prey_range);
+  prey_range_slider->onValueChange([&values](float value) {
+    values.sliders.prey_range = constants::max_prey_range * 0.1 * value;
+    values.changed = true;
+  });
   gui.add(prey_range_slider);
   panel.insert(prey_range_slider, widget_key::prey_range_slider);
 
@@ -151,92 +206,80 @@ void initialize_panel(tgui::GuiSFML& gui, Panel& panel, bool& display_tree,
   panel.insert(separation_prey_button, widget_key::separation_range_button);
 };
 
-bool update_boid_number(int& boid_number, Panel& panel) {
-  if (static_cast<int>(
-          panel.retrieve<tgui::Slider>(widget_key::boid_number_slider)
-              ->getValue()) != boid_number) {
-    boid_number = static_cast<int>(
-        panel.retrieve<tgui::Slider>(widget_key::boid_number_slider)
-            ->getValue());
-
-    // update value on label
-    panel.retrieve<tgui::Label>(widget_key::boid_number_text)
-        ->setText("Number of Boids: " + std::to_string(boid_number));
-
-    return true;
+void update_fps(Panel& panel, int& shown_fps, double fps) {
+  int rounded = static_cast<int>(std::lround(fps));
+  if (rounded != shown_fps) {
+    shown_fps = rounded;
+    panel.retrieve<tgui::Label>(widget_key::fps_text)
+        ->setText("fps: " + std::to_string(shown_fps));
   }
-  return false;
 }
 
-bool update_predator_number(int& predator_number, Panel& panel) {
-  if (panel.retrieve<tgui::Slider>(widget_key::predator_number_slider)
-          ->getValue() != predator_number) {
-    predator_number = static_cast<int>(
-        panel.retrieve<tgui::Slider>(widget_key::predator_number_slider)
-            ->getValue());
-
-    // update value on label
-    panel.retrieve<tgui::Label>(widget_key::predator_number_text)
-        ->setText("Number of Predators: " + std::to_string(predator_number));
-    return true;
-  }
-  return false;
-}
-
-void update_from_panel(Panel& panel, double& fps, double& cohesion_coefficent,
-                       double& alignment_coefficent,
-                       double& separation_coefficent, double& range,
-                       double& separation_range, double& prey_range) {
-  panel.retrieve<tgui::Label>(widget_key::fps_text)
-      ->setText("fps: " + std::to_string(fps));
-
-  // the 0.1 coefficent is needed because the max value of panel by deafult is
-  // 10, so multiplyng it  0.1 rescales it to 1
-  cohesion_coefficent =
+Slider_values initial_slider_values() {
+  // the scaling of the callbacks of the sliders
+  return Slider_values{
       constants::max_cohesion_strength * 0.1 *
-      (panel.retrieve<tgui::Slider>(widget_key::cohesion_strength_slider)
-           ->getValue());
-
-  alignment_coefficent =
+          constants::init_cohesion_strength,
       constants::max_alignment_strength * 0.1 *
-      (panel.retrieve<tgui::Slider>(widget_key::alignment_strength_slider)
-           ->getValue());
-
-  separation_coefficent =
+          constants::init_alignment_strength,
       constants::max_separation_strength * 0.1 *
-      (panel.retrieve<tgui::Slider>(widget_key::separation_strength_slider)
-           ->getValue());
-
-  range = constants::max_range * 0.1 *
-          (panel.retrieve<tgui::Slider>(widget_key::range_slider)->getValue());
+          constants::init_separation_strength,
+      constants::max_range * 0.1 * constants::init_range,
+      constants::max_separation_range * 0.1 * constants::init_separation_range,
+      constants::max_prey_range * 0.1 * constants::init_prey_range};
+}
 
-  separation_range =
-      constants::max_separation_range * 0.1 *
-      (panel.retrieve<tgui::Slider>(widget_key::separation_range_slider)
-           ->getValue());
+void set_panel(Panel& panel, const Slider_values& values, int boid_number,
+               int predator_number) {
+  // inverse of the scaling of the callbacks of the sliders
+  panel.retrieve<tgui::Slider>(widget_key::cohesion_strength_slider)
+      ->setValue(values.cohesion_coefficent /
+                 (constants::max_cohesion_strength * 0.1));
+  panel.retrieve<tgui::Slider>(widget_key::alignment_strength_slider)
+      ->setValue(values.alignment_coefficent /
+                 (constants::max_alignment_strength * 0.1));
+  panel.retrieve<tgui::Slider>(widget_key::separation_strength_slider)
+      ->setValue(values.separation_coefficent /
+                 (constants::max_separation_strength * 0.1));
+  panel.retrieve<tgui::Slider>(widget_key::range_slider)
+      ->setValue(values.range / (constants::max_range * 0.1));
+  panel.retrieve<tgui::Slider>(widget_key::separation_range_slider)
+      ->setValue(values.separation_range /
+                 (constants::max_separation_range * 0.1));
+  panel.retrieve<tgui::Slider>(widget_key::prey_range_slider)
+      ->setValue(values.prey_range / (constants::max_prey_range * 0.1));
+
+  // the numbers may exceed the maximums of the configuration, e.g. for a
+  // checkpoint written with other settings. the sliders are stretched, so
+  // they do not clamp the numbers and the flocks are not cut down
+  auto boid_number_slider =
+      panel.retrieve<tgui::Slider>(widget_key::boid_number_slider);
+  if (boid_number > boid_number_slider->getMaximum()) {
+    boid_number_slider->setMaximum(boid_number);
+  }
+  boid_number_slider->setValue(boid_number);
 
-  prey_range =
-      constants::max_prey_range * 0.1 *
-      (panel.retrieve<tgui::Slider>(widget_key::prey_range_slider)->getValue());
+  auto predator_number_slider =
+      panel.retrieve<tgui::Slider>(widget_key::predator_number_slider);
+  if (predator_number > predator_number_slider->getMaximum()) {
+    predator_number_slider->setMaximum(predator_number);
+  }
+  predator_number_slider->setValue(predator_number);
 }
 
 void display_ranges(double range, double separation_range, double prey_range,
                     bool display_range, bool display_separation_range,
-                    bool display_prey_range, std::vector<Boid>& boid_vector,
+                    bool display_prey_range, const Boid& boid,
                     sf::RenderWindow& window) {
-  // if corresponding button is pressed, displays the ranges of the first boid
-  // in the vector;
-  if (!boid_vector.empty()) {
-    if (display_range)
-      display_circle(window, range, boid_vector[0], constants::range_color);
-
-    if (display_separation_range)
-      display_circle(window, separation_range, boid_vector[0],
-                     constants::separation_range_color);
-
-    if (display_prey_range)
-      display_circle(window, prey_range, boid_vector[0],
-                     constants::prey_range_color);
-  }
+  // if corresponding button is pressed, displays the ranges of the boid
+  if (display_range)
+    display_circle(window, range, boid, constants::range_color);
+
+  if (display_separation_range)
+    display_circle(window, separation_range, boid,
+                   constants::separation_range_color);
+
+  if (display_prey_range)
+    display_circle(window, prey_range, boid, constants::prey_range_color);
 }
 }  // namespace boids
\ No newline at end of file
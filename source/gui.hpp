@@ -7,6 +7,7 @@
 #include <string>
 
 #include "boid.hpp"
+#include "checkpoint.hpp"
 #include "sfml.hpp"
 
 // enum class, for panel map attribute
@@ -80,38 +81,48 @@ class Panel {
   };
 };
 
-// initializes the panel with the various GUI objects
+// the values shown by the panel. the callbacks of the sliders write them as
+// soon as a slider moves, so nothing is read from the widgets every frame
+struct Panel_values {
+  Slider_values sliders{};
+  int boid_number{};
+  int predator_number{};
+  // set by the callbacks, cleared by whoever hands the values on
+  bool changed{true};
+};
+
+// initializes the panel with the various GUI objects, and the values with the
+// initial positions of the sliders
 // Param 1: gui, to which widgets get added
 // Param 2: panel, where widgets get inserted
 // Param 3: bool for quad tree button
 // Param 4: bool for range button
 // Param 5: bool for separation range button
 // Param 6: bool for prey range button
-void initialize_panel(tgui::GuiSFML&, Panel&, bool&, bool&, bool&, bool&);
-
-// updates the number of boids from the slider position. returns false if no
-// update was necessary, true otherwise
-// Param 1: number of boids.
-// Param 2: panel where slider is inserted
-bool update_boid_number(int&, Panel& panel);
-
-// updates the number of predators from the slider position. returns false if no
-// update was necessary, true otherwise
-// Param 1: number of predators.
-// Param 2: panel where slider is inserted
-bool update_predator_number(int&, Panel& panel);
-
-// updates the various values from the slider positions.
+// Param 7: the values, kept up to date by the sliders
+// Param 8: the configuration, for the maximum numbers of birds
+void initialize_panel(tgui::GuiSFML&, Panel&, bool&, bool&, bool&, bool&,
+                      Panel_values&, const Config&);
+
+// shows the frames per second, rounded. the label is only rewritten when the
+// rounded value changes
+//  Param 1: panel where the label is inserted
+//  Param 2: the value shown, updated
+//  Param 3: fps value
+void update_fps(Panel&, int&, double);
+
+// returns the values of the sliders when the panel is initialized, i.e. the
+// constants::init_* positions
+Slider_values initial_slider_values();
+
+// moves the sliders to the provided values and numbers of birds, e.g. the
+// ones of a checkpoint. the values get updated by the callbacks of the
+// sliders. the number sliders are stretched to numbers above their maximum
 //  Param 1: panel where sliders are inserted
-//  Param 2: fps value
-//  Param 3: coehesion coefficent
-//  Param 4: alignment coefficent
-//  Param 5: separation coefficent
-//  Param 6: range value
-//  Param 7: separation range value
-//  Param 8: prey range value
-void update_from_panel(Panel&, double&, double&, double&, double&, double&,
-                       double&, double&);
+//  Param 2: the values
+//  Param 3: number of boids
+//  Param 4: number of predators
+void set_panel(Panel&, const Slider_values&, int, int);
 
 // displayes the ranges if the buttons are pushed
 //  Param 1 range value
@@ -120,10 +131,10 @@ void update_from_panel(Panel&, double&, double&, double&, double&, double&,
 //  Param 4 is range displayed
 //  Param 5 is separation range displayed
 //  Param 6 is prey range displayed
-//  Param 7 vector of boids
+//  Param 7 the boid, the first of the vector
 //  Param 8 window object
-void display_ranges(double, double, double, bool, bool, bool,
-                    std::vector<Boid>&, sf::RenderWindow&);
+void display_ranges(double, double, double, bool, bool, bool, const Boid&,
+                    sf::RenderWindow&);
 
 }  // namespace boids
 #endif
\ No newline at end of file
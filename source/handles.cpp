@@ -0,0 +1,70 @@
+#include "handles.hpp"
+
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <utility>  //for std::swap
+#include <vector>
+
+namespace boids {
+int Handles::size() const { return static_cast<int>(m_handle.size()); }
+
+int Handles::capacity() const { return static_cast<int>(m_index.size()); }
+
+void Handles::spawn(int count) {
+  assert(count >= 0);
+  for (int i = 0; i != count; ++i) {
+    int handle{};
+    if (m_free.empty()) {
+      handle = capacity();
+      m_index.push_back(-1);
+    } else {
+      handle = m_free.back();
+      m_free.pop_back();
+    }
+    m_index[handle] = size();
+    m_handle.push_back(handle);
+  }
+}
+
+void Handles::retire(int count) {
+  assert(count >= 0 && count <= size());
+  for (int i = 0; i != count; ++i) {
+    int handle = m_handle.back();
+    m_handle.pop_back();
+    m_index[handle] = -1;
+    m_free.push_back(handle);
+  }
+}
+
+void Handles::reorder(const std::vector<int>& order) {
+  assert(static_cast<int>(order.size()) == size());
+  std::vector<int> reordered(order.size());
+  for (int i = 0; i != size(); ++i) {
+    reordered[i] = m_handle[order[i]];
+    m_index[reordered[i]] = i;
+  }
+  m_handle.swap(reordered);
+}
+
+void Handles::swap(int first, int second) {
+  assert(first >= 0 && first < size() && second >= 0 && second < size());
+  std::swap(m_handle[first], m_handle[second]);
+  m_index[m_handle[first]] = first;
+  m_index[m_handle[second]] = second;
+}
+
+int Handles::index(int handle) const {
+  assert(handle >= 0 && handle < capacity());
+  return m_index[handle];
+}
+
+int Handles::handle(int index) const {
+  assert(index >= 0 && index < size());
+  return m_handle[index];
+}
+
+std::size_t Handles::memory_usage() const {
+  return (m_index.capacity() + m_handle.capacity() + m_free.capacity()) *
+         sizeof(int);
+}
+}  // namespace boids
@@ -0,0 +1,83 @@
+// stable handles to the birds of a vector. the index of a bird changes when
+// birds are reordered (see spatial_sort) or retired, its handle does not, so
+// a bird can be followed for the whole simulation.
+#ifndef HANDLES_HPP
+#define HANDLES_HPP
+
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <random>   //for std::mt19937 and std::uniform_int_distribution
+#include <utility>  //for std::swap
+#include <vector>
+
+namespace boids {
+class Handles {
+  // index of the bird with each handle, -1 for retired handles
+  std::vector<int> m_index;
+  // handle of the bird at each index
+  std::vector<int> m_handle;
+  // retired handles, given again to the next spawned birds
+  std::vector<int> m_free;
+
+ public:
+  // returns the number of birds
+  int size() const;
+
+  // returns the number of handles ever given. handles are in [0, capacity())
+  int capacity() const;
+
+  // gives handles to birds appended to the end of the vector, reusing
+  // retired handles first
+  // Param 1: the number of birds
+  void spawn(int);
+
+  // retires the handles of the birds removed from the end of the vector
+  // Param 1: the number of birds
+  void retire(int);
+
+  // updates the indices after the birds got reordered: the bird now at index
+  // i was at index order[i]
+  // Param 1: the order
+  void reorder(const std::vector<int>&);
+
+  // swaps the handles of the birds at the provided indices, after the birds
+  // themselves got swapped
+  // Param 1: the index of a bird
+  // Param 2: the index of the other bird
+  void swap(int, int);
+
+  // returns the index of the bird with the provided handle, -1 if retired
+  // Param 1: the handle
+  int index(int) const;
+
+  // returns the handle of the bird at the provided index
+  // Param 1: the index
+  int handle(int) const;
+
+  // returns the number of bytes allocated by the handles
+  std::size_t memory_usage() const;
+};
+
+// template function, so it can handle both boids and predators
+// moves birds picked at random to the end of the vector, along with their
+// handles, so that retiring the birds at the end thins the flock out evenly:
+// after a spatial_sort the end of the vector is one region of the world
+// Param 1: vector of boids/predators
+// Param 2: the handles of the birds
+// Param 3: the number of birds moved
+// Param 4: the random engine
+template <class T>
+void move_random_to_end(std::vector<T>& bird_vec, Handles& handles, int count,
+                        std::mt19937& mt) {
+  const int size = static_cast<int>(bird_vec.size());
+  assert(handles.size() == size);
+  assert(count >= 0 && count <= size);
+  for (int last = size - 1; last != size - 1 - count; --last) {
+    std::uniform_int_distribution<int> pick{0, last};
+    int i = pick(mt);
+    std::swap(bird_vec[i], bird_vec[last]);
+    handles.swap(i, last);
+  }
+}
+}  // namespace boids
+#endif
@@ -0,0 +1,250 @@
+#include "kd_tree.hpp"
+
+#include <algorithm>  //for std::nth_element, std::min, std::max
+#include <array>
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <utility>  //for std::pair
+#include <vector>
+
+#include "boid.hpp"
+#include "neighbours.hpp"
+#include "parallel.hpp"
+#include "point.hpp"
+#include "quadtree.hpp"
+
+namespace boids {
+Kd_tree::Kd_tree(int capacity) : m_capacity{capacity} {
+  assert(capacity > 0);
+}
+
+void Kd_tree::set_capacity(int capacity) {
+  assert(capacity > 0);
+  m_capacity = capacity;
+}
+
+std::pair<int, int> Kd_tree::node_count(int size) const {
+  // a cell with more than m_capacity boids has two children, with
+  // size / 2 and size - size / 2 boids. the children of trees built on size
+  // and size + 1 boids are built on half and half + 1 boids, so both counts
+  // follow from the counts of half.
+  if (size + 1 <= m_capacity) {
+    return {1, 1};
+  }
+
+  int half = size / 2;
+  auto [count_half, count_half_plus_one] = node_count(half);
+
+  int count{};
+  int count_plus_one{};
+  if (size % 2 == 0) {
+    count = 1 + 2 * count_half;
+    count_plus_one = 1 + count_half + count_half_plus_one;
+  } else {
+    count = 1 + count_half + count_half_plus_one;
+    count_plus_one = 1 + 2 * count_half_plus_one;
+  }
+
+  if (size <= m_capacity) {
+    count = 1;
+  }
+  return {count, count_plus_one};
+}
+
+void Kd_tree::build_node(int index, int first, int last, int parallel_depth) {
+  assert(last > first);
+  Node& node = m_nodes[index];
+  node.first = first;
+  node.last = last;
+  node.min_x = node.max_x = m_entries[first].pos.x();
+  node.min_y = node.max_y = m_entries[first].pos.y();
+  for (int i = first + 1; i != last; ++i) {
+    node.min_x = std::min(node.min_x, m_entries[i].pos.x());
+    node.max_x = std::max(node.max_x, m_entries[i].pos.x());
+    node.min_y = std::min(node.min_y, m_entries[i].pos.y());
+    node.max_y = std::max(node.max_y, m_entries[i].pos.y());
+  }
+
+  if (last - first <= m_capacity) {
+    node.right = -1;
+    return;
+  }
+
+  // splits the widest side at the median boid
+  int middle = first + (last - first) / 2;
+  if (node.max_x - node.min_x >= node.max_y - node.min_y) {
+    std::nth_element(m_entries.begin() + first, m_entries.begin() + middle,
+                     m_entries.begin() + last,
+                     [](const Entry& a, const Entry& b) {
+                       return a.pos.x() < b.pos.x();
+                     });
+  } else {
+    std::nth_element(m_entries.begin() + first, m_entries.begin() + middle,
+                     m_entries.begin() + last,
+                     [](const Entry& a, const Entry& b) {
+                       return a.pos.y() < b.pos.y();
+                     });
+  }
+
+  // the number of cells of the left child is known in advance, so the two
+  // children can be built at the same time in separate parts of m_nodes
+  int left = index + 1;
+  int right = left + node_count(middle - first).first;
+  node.right = right;
+
+  if (parallel_depth > 0) {
+    parallel_tasks(2, [&](int child) {
+      if (child == 0) {
+        build_node(left, first, middle, parallel_depth - 1);
+      } else {
+        build_node(right, middle, last, parallel_depth - 1);
+      }
+    });
+  } else {
+    build_node(left, first, middle, 0);
+    build_node(right, middle, last, 0);
+  }
+}
+
+void Kd_tree::build(const std::vector<Boid>& boid_vec) {
+  int size = static_cast<int>(boid_vec.size());
+
+  m_entries.resize(size);
+  parallel_for(size, [&](int i) {
+    m_entries[i] = Entry{boid_vec[i].pos(), &boid_vec[i]};
+  });
+
+  m_nodes.clear();
+  if (size == 0) {
+    return;
+  }
+  m_nodes.resize(node_count(size).first);
+
+  // the cells of the first levels are split between the threads
+  int parallel_depth{0};
+  while ((1 << parallel_depth) < chunk_count(size)) {
+    ++parallel_depth;
+  }
+  build_node(0, 0, size, parallel_depth);
+}
+
+void Kd_tree::push_children(int index, double x, double y,
+                            bool closest_first, Stack& stack,
+                            int& stack_size) const {
+  assert(m_nodes[index].right != -1);
+  assert(stack_size + 2 <= static_cast<int>(stack.size()));
+  int left = index + 1;
+  int right = m_nodes[index].right;
+
+  // the child pushed last is visited first
+  if (closest_first && m_nodes[right].squared_distance(x, y) <
+                           m_nodes[left].squared_distance(x, y)) {
+    stack[stack_size++] = left;
+    stack[stack_size++] = right;
+  } else {
+    stack[stack_size++] = right;
+    stack[stack_size++] = left;
+  }
+}
+
+void Kd_tree::query(double range, const Boid& boid,
+                    std::vector<const Boid*>& in_range,
+                    int max_neighbours) const {
+  assert(range >= 0.);
+  assert(max_neighbours >= 0);
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  double x = boid.pos().x();
+  double y = boid.pos().y();
+  double squared_range = range * range;
+
+  Stack stack;
+  int stack_size{0};
+  stack[stack_size++] = 0;
+
+  while (stack_size != 0) {
+    int index = stack[--stack_size];
+    const Node& node = m_nodes[index];
+
+    if (x + range < node.min_x || x - range > node.max_x ||
+        y + range < node.min_y || y - range > node.max_y) {
+      continue;
+    }
+
+    if (node.right != -1) {
+      // with a limit, the closest cells are visited first, so the kept
+      // neighbours surround the boid instead of lying on one side
+      push_children(index, x, y, max_neighbours != 0, stack, stack_size);
+      continue;
+    }
+
+    for (int i = node.first; i != node.last; ++i) {
+      double dx = m_entries[i].pos.x() - x;
+      double dy = m_entries[i].pos.y() - y;
+      const Boid* other_boid_ptr = m_entries[i].boid_ptr;
+      if (dx * dx + dy * dy < squared_range && other_boid_ptr != &boid) {
+        // early out, once enough neighbours have been found
+        if (max_neighbours != 0 &&
+            static_cast<int>(in_range.size()) >= max_neighbours) {
+          return;
+        }
+        in_range.push_back(other_boid_ptr);
+      }
+    }
+  }
+}
+
+void Kd_tree::k_nearest(int k, const Boid& boid,
+                        std::vector<const Boid*>& nearest_boids) const {
+  assert(k >= 0);
+  Nearest_boids nearest{k};
+  double x = boid.pos().x();
+  double y = boid.pos().y();
+
+  Stack stack;
+  int stack_size{0};
+  if (!m_nodes.empty()) {
+    stack[stack_size++] = 0;
+  }
+
+  while (stack_size != 0) {
+    int index = stack[--stack_size];
+    const Node& node = m_nodes[index];
+
+    // cells farther than the farthest kept boid cannot improve the result
+    if (node.squared_distance(x, y) >= nearest.worst()) {
+      continue;
+    }
+
+    if (node.right != -1) {
+      push_children(index, x, y, true, stack, stack_size);
+      continue;
+    }
+
+    for (int i = node.first; i != node.last; ++i) {
+      const Boid* other_boid_ptr = m_entries[i].boid_ptr;
+      if (other_boid_ptr != &boid) {
+        double dx = m_entries[i].pos.x() - x;
+        double dy = m_entries[i].pos.y() - y;
+        nearest.offer(dx * dx + dy * dy, other_boid_ptr);
+      }
+    }
+  }
+
+  nearest.write(nearest_boids);
+}
+
+std::size_t Kd_tree::memory_usage() const {
+  return m_nodes.capacity() * sizeof(Node) +
+         m_entries.capacity() * sizeof(Entry);
+}
+
+void Kd_tree::cells(sf::VertexArray& lines) const {
+  for (const auto& node : m_nodes) {
+    append_cell(lines, node.min_x, node.min_y, node.max_x - node.min_x,
+                node.max_y - node.min_y);
+  }
+}
+}  // namespace boids
@@ -0,0 +1,126 @@
+// implementation of space partitioning by using a k-d tree: each cell is split
+// in two halves with the same number of boids, along its widest side. unlike
+// the quad trees, cells follow the boids, so the tree stays balanced when the
+// flock gathers in a few dense clusters.
+#ifndef KD_TREE_HPP
+#define KD_TREE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>  //for std::max
+#include <array>
+#include <cstddef>  //for std::size_t
+#include <utility>  //for std::pair
+#include <vector>
+
+#include "boid.hpp"
+#include "constants.hpp"
+#include "point.hpp"
+
+namespace boids {
+class Kd_tree {
+  // cell of the tree. the boids of a cell are the ones in [first, last) of
+  // m_entries. the left child always follows its parent in m_nodes, the
+  // right child is stored explicitly. leaves have right = -1.
+  struct Node {
+    // smallest box containing the boids of the cell
+    double min_x{};
+    double min_y{};
+    double max_x{};
+    double max_y{};
+    int first{};
+    int last{};
+    int right{-1};
+
+    // square of the distance between the point and the box of the cell, 0
+    // if the point is inside
+    double squared_distance(double x, double y) const {
+      double dx = std::max({min_x - x, 0., x - max_x});
+      double dy = std::max({min_y - y, 0., y - max_y});
+      return dx * dx + dy * dy;
+    }
+  };
+
+  // boid with a copy of its position, so query() reads contiguous memory
+  struct Entry {
+    Point pos{};
+    const Boid* boid_ptr{};
+  };
+
+  // maximum number of boids in a leaf cell
+  int m_capacity{};
+
+  std::vector<Node> m_nodes;
+  std::vector<Entry> m_entries;
+
+  // cells still to visit during a search. each visit removes one cell and
+  // adds at most two, and the tree is balanced, so the stack holds at most
+  // one cell per level plus one
+  using Stack = std::array<int, 64>;
+
+  // pushes the children of the provided cell on the stack, so that the left
+  // one is popped first, or the closest to the provided point
+  // Param 1: index of the cell
+  // Param 2: x of the point
+  // Param 3: y of the point
+  // Param 4: true to visit the closest child first
+  // Param 5: the stack
+  // Param 6: the size of the stack
+  void push_children(int, double, double, bool, Stack&, int&) const;
+
+  // returns the number of cells of the trees built on the provided number of
+  // boids and on one more boid.
+  // Param 1: the number of boids
+  std::pair<int, int> node_count(int) const;
+
+  // builds the cell with the provided index and its children. the children
+  // of cells less deep than the provided parallel depth are built as two
+  // tasks of the thread pool.
+  // Param 1: index of the cell
+  // Param 2: first boid of the cell
+  // Param 3: last boid of the cell (excluded)
+  // Param 4: parallel depth
+  void build_node(int, int, int, int);
+
+ public:
+  // Param 1: m_capacity
+  explicit Kd_tree(int);
+
+  // changes the capacity used by the next build()
+  // Param 1: the capacity
+  void set_capacity(int);
+
+  // rebuilds the tree from the provided boids. the tree stores pointers to
+  // them, and copies of their positions at the time of the build.
+  // Param 1: the vector of boids
+  void build(const std::vector<Boid>&);
+
+  // populates the provided vector of boid pointers with pointers to boids
+  // contained within the tree that are within the specified range from the
+  // given boid (itself excluded).
+  // if a maximum number of neighbours is given, the query stops as soon as
+  // the vector holds that many boids. cells are then visited from the closest
+  // to the boid, so the same boids are always selected for the same tree.
+  // Param 1: the range
+  // Param 2: the boid
+  // Param 3: the vector of boid pointers
+  // Param 4: maximum number of neighbours, 0 for no limit
+  void query(double, const Boid&, std::vector<const Boid*>&, int = 0) const;
+
+  // populates the provided vector of boid pointers with pointers to the k
+  // boids contained within the tree closest to the given boid (itself
+  // excluded), from the closest. fewer if the tree has fewer boids.
+  // Param 1: k
+  // Param 2: the boid
+  // Param 3: the vector of boid pointers
+  void k_nearest(int, const Boid&, std::vector<const Boid*>&) const;
+
+  // returns the number of bytes allocated by the tree
+  std::size_t memory_usage() const;
+
+  // appends the edges of the cells of the tree to the vertex array, see
+  // append_cell
+  // Param 1: the vertex array of lines
+  void cells(sf::VertexArray&) const;
+};
+}  // namespace boids
+#endif
@@ -0,0 +1,368 @@
+#include "linear_quadtree.hpp"
+
+#include <algorithm>  //for std::clamp, std::partition_point, std::sort
+#include <array>
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <cstdint>
+#include <functional>  //for std::greater
+#include <numeric>  //for std::iota
+#include <utility>  //for std::pair
+#include <vector>
+
+#include "boid.hpp"
+#include "neighbours.hpp"
+#include "parallel.hpp"
+#include "point.hpp"
+
+namespace boids {
+
+namespace {
+// spreads the lower 16 bits of the value over the even bits
+std::uint32_t spread_bits(std::uint32_t value) {
+  value &= 0x0000ffff;
+  value = (value | (value << 8)) & 0x00ff00ff;
+  value = (value | (value << 4)) & 0x0f0f0f0f;
+  value = (value | (value << 2)) & 0x33333333;
+  value = (value | (value << 1)) & 0x55555555;
+  return value;
+}
+
+// discretizes the coordinate on the grid of the morton code.
+// Param 1: the coordinate
+// Param 2: the lowest value of the coordinate in the rectangle
+// Param 3: the size of the rectangle along the coordinate
+std::uint32_t grid_coordinate(double value, double lowest, double size) {
+  constexpr double cells = 1 << morton_bits;
+  double cell = (value - lowest) / size * cells;
+  return static_cast<std::uint32_t>(std::clamp(cell, 0., cells - 1.));
+}
+}  // namespace
+
+std::uint32_t morton_code(const Point& p, const Rectangle& rect) {
+  assert(rect.w > 0. && rect.h > 0.);
+  std::uint32_t x = grid_coordinate(p.x(), rect.x - rect.w, 2. * rect.w);
+  std::uint32_t y = grid_coordinate(p.y(), rect.y - rect.h, 2. * rect.h);
+  return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+std::vector<int> spatial_sort(std::vector<Boid>& boid_vec,
+                              const Rectangle& rect) {
+  std::vector<int> order(boid_vec.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (boid_vec.size() < 3) {
+    return order;
+  }
+
+  // pairs of code and position in boid_vec
+  std::vector<std::pair<std::uint32_t, int>> keys(boid_vec.size() - 1);
+  parallel_for(static_cast<int>(keys.size()), [&](int i) {
+    keys[i] = {morton_code(boid_vec[i + 1].pos(), rect), i + 1};
+  });
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<Boid> sorted;
+  sorted.reserve(boid_vec.size());
+  sorted.push_back(boid_vec[0]);
+  for (int i = 0; i != static_cast<int>(keys.size()); ++i) {
+    sorted.push_back(boid_vec[keys[i].second]);
+    order[i + 1] = keys[i].second;
+  }
+  boid_vec.swap(sorted);
+  return order;
+}
+
+Linear_quad_tree::Linear_quad_tree(int capacity, const Rectangle& boundary,
+                                   int max_depth)
+    : m_capacity{capacity},
+      m_max_depth{std::min(max_depth, morton_bits)},
+      m_boundary{boundary} {
+  assert(capacity > 0);
+  assert(max_depth >= 0);
+}
+
+void Linear_quad_tree::set_capacity(int capacity) {
+  assert(capacity > 0);
+  m_capacity = capacity;
+}
+
+void Linear_quad_tree::sort() {
+  // least significant digit radix sort, one byte at a time. each chunk of
+  // the array counts its digits, then writes its elements in the positions
+  // given by the counts of the previous chunks, so the sort is stable.
+  int size = static_cast<int>(m_order.size());
+  int chunks = chunk_count(size);
+  std::vector<std::array<int, 256>> counts(chunks);
+  m_sort_buffer.resize(size);
+
+  for (int shift = 0; shift != 32; shift += 8) {
+    parallel_chunks(size, [&](int chunk, int begin, int end) {
+      counts[chunk].fill(0);
+      for (int i = begin; i != end; ++i) {
+        ++counts[chunk][(m_unsorted_codes[m_order[i]] >> shift) & 0xff];
+      }
+    });
+
+    // turns counts into the first position of each digit of each chunk
+    int position{0};
+    for (int digit = 0; digit != 256; ++digit) {
+      for (int chunk = 0; chunk != chunks; ++chunk) {
+        int count = counts[chunk][digit];
+        counts[chunk][digit] = position;
+        position += count;
+      }
+    }
+
+    parallel_chunks(size, [&](int chunk, int begin, int end) {
+      for (int i = begin; i != end; ++i) {
+        int digit = (m_unsorted_codes[m_order[i]] >> shift) & 0xff;
+        m_sort_buffer[counts[chunk][digit]++] = m_order[i];
+      }
+    });
+
+    m_order.swap(m_sort_buffer);
+  }
+}
+
+void Linear_quad_tree::subdivide(int index, int depth) {
+  Node node = m_nodes[index];
+
+  if (node.last - node.first <= m_capacity || depth == m_max_depth) {
+    return;
+  }
+
+  // the two bits of the code that select the child cell at this depth
+  int shift = 2 * (morton_bits - 1 - depth);
+
+  int first_child = static_cast<int>(m_nodes.size());
+  int begin = node.first;
+  for (std::uint32_t q = 0; q != 4; ++q) {
+    // codes are sorted, so the boids of each quadrant are contiguous
+    int end = static_cast<int>(
+        std::partition_point(m_codes.begin() + begin,
+                             m_codes.begin() + node.last,
+                             [q, shift](std::uint32_t code) {
+                               return ((code >> shift) & 3) <= q;
+                             }) -
+        m_codes.begin());
+
+    if (end != begin) {
+      assert(((m_codes[begin] >> shift) & 3) == q);
+      // bit 0 of the quadrant selects east, bit 1 selects north
+      Rectangle cell{
+          node.boundary.x + ((q & 1) ? 1. : -1.) * node.boundary.w / 2.,
+          node.boundary.y + ((q & 2) ? 1. : -1.) * node.boundary.h / 2.,
+          node.boundary.w / 2., node.boundary.h / 2.};
+      Node child{};
+      child.boundary = cell;
+      child.first = begin;
+      child.last = end;
+      m_nodes.push_back(child);
+    }
+    begin = end;
+  }
+
+  int child_count = static_cast<int>(m_nodes.size()) - first_child;
+  m_nodes[index].first_child = first_child;
+  m_nodes[index].child_count = child_count;
+
+  for (int child = first_child; child != first_child + child_count; ++child) {
+    subdivide(child, depth + 1);
+  }
+}
+
+void Linear_quad_tree::build(const std::vector<Boid>& boid_vec) {
+  int size = static_cast<int>(boid_vec.size());
+
+  m_nodes.clear();
+  m_unsorted_codes.resize(size);
+  m_order.resize(size);
+  m_boids_ptr.resize(size);
+  m_codes.resize(size);
+  m_positions.resize(size);
+
+  parallel_for(size, [&](int i) {
+    m_unsorted_codes[i] = morton_code(boid_vec[i].pos(), m_boundary);
+    m_order[i] = i;
+  });
+
+  sort();
+
+  parallel_for(size, [&](int i) {
+    m_boids_ptr[i] = &boid_vec[m_order[i]];
+    m_codes[i] = m_unsorted_codes[m_order[i]];
+    m_positions[i] = boid_vec[m_order[i]].pos();
+  });
+
+  if (size == 0) {
+    return;
+  }
+
+  Node root{};
+  root.boundary = m_boundary;
+  root.first = 0;
+  root.last = size;
+  m_nodes.push_back(root);
+  subdivide(0, 0);
+
+  // children always come after their parent, so going backwards every
+  // child box is ready before the box of its parent
+  for (auto node = m_nodes.rbegin(); node != m_nodes.rend(); ++node) {
+    if (node->child_count == 0) {
+      node->min_x = node->max_x = m_positions[node->first].x();
+      node->min_y = node->max_y = m_positions[node->first].y();
+      for (int i = node->first + 1; i != node->last; ++i) {
+        node->min_x = std::min(node->min_x, m_positions[i].x());
+        node->max_x = std::max(node->max_x, m_positions[i].x());
+        node->min_y = std::min(node->min_y, m_positions[i].y());
+        node->max_y = std::max(node->max_y, m_positions[i].y());
+      }
+    } else {
+      const Node& first = m_nodes[node->first_child];
+      node->min_x = first.min_x;
+      node->max_x = first.max_x;
+      node->min_y = first.min_y;
+      node->max_y = first.max_y;
+      for (int child = node->first_child + 1;
+           child != node->first_child + node->child_count; ++child) {
+        node->min_x = std::min(node->min_x, m_nodes[child].min_x);
+        node->max_x = std::max(node->max_x, m_nodes[child].max_x);
+        node->min_y = std::min(node->min_y, m_nodes[child].min_y);
+        node->max_y = std::max(node->max_y, m_nodes[child].max_y);
+      }
+    }
+  }
+}
+
+void Linear_quad_tree::push_children(const Node& node, double x, double y,
+                                     bool closest_first, Stack& stack,
+                                     int& stack_size) const {
+  assert(node.child_count != 0);
+  assert(stack_size + node.child_count <= static_cast<int>(stack.size()));
+
+  if (!closest_first) {
+    // pushed backwards, so children are visited in morton order
+    for (int child = node.first_child + node.child_count - 1;
+         child >= node.first_child; --child) {
+      stack[stack_size++] = child;
+    }
+    return;
+  }
+
+  // closest child pushed last, so it is visited first. ties keep the morton
+  // order, so the order is deterministic
+  std::array<std::pair<double, int>, 4> children;
+  for (int i = 0; i != node.child_count; ++i) {
+    int child = node.first_child + i;
+    children[i] = {m_nodes[child].squared_distance(x, y), child};
+  }
+  std::sort(children.begin(), children.begin() + node.child_count,
+            std::greater<>{});
+  for (int i = 0; i != node.child_count; ++i) {
+    stack[stack_size++] = children[i].second;
+  }
+}
+
+void Linear_quad_tree::query(double range, const Boid& boid,
+                             std::vector<const Boid*>& in_range,
+                             int max_neighbours) const {
+  assert(range >= 0.);
+  assert(max_neighbours >= 0);
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  double x = boid.pos().x();
+  double y = boid.pos().y();
+  double squared_range = range * range;
+
+  Stack stack;
+  int stack_size{0};
+  stack[stack_size++] = 0;
+
+  while (stack_size != 0) {
+    const Node& node = m_nodes[stack[--stack_size]];
+
+    if (x + range < node.min_x || x - range > node.max_x ||
+        y + range < node.min_y || y - range > node.max_y) {
+      continue;
+    }
+
+    if (node.child_count != 0) {
+      // with a limit, the closest cells are visited first, so the kept
+      // neighbours surround the boid instead of lying on one side
+      push_children(node, x, y, max_neighbours != 0, stack, stack_size);
+      continue;
+    }
+
+    for (int i = node.first; i != node.last; ++i) {
+      double dx = m_positions[i].x() - x;
+      double dy = m_positions[i].y() - y;
+      if (dx * dx + dy * dy < squared_range && m_boids_ptr[i] != &boid) {
+        // early out, once enough neighbours have been found
+        if (max_neighbours != 0 &&
+            static_cast<int>(in_range.size()) >= max_neighbours) {
+          return;
+        }
+        in_range.push_back(m_boids_ptr[i]);
+      }
+    }
+  }
+}
+
+void Linear_quad_tree::k_nearest(
+    int k, const Boid& boid, std::vector<const Boid*>& nearest_boids) const {
+  assert(k >= 0);
+  Nearest_boids nearest{k};
+  double x = boid.pos().x();
+  double y = boid.pos().y();
+
+  Stack stack;
+  int stack_size{0};
+  if (!m_nodes.empty()) {
+    stack[stack_size++] = 0;
+  }
+
+  while (stack_size != 0) {
+    const Node& node = m_nodes[stack[--stack_size]];
+
+    // cells farther than the farthest kept boid cannot improve the result
+    if (node.squared_distance(x, y) >= nearest.worst()) {
+      continue;
+    }
+
+    if (node.child_count != 0) {
+      push_children(node, x, y, true, stack, stack_size);
+      continue;
+    }
+
+    for (int i = node.first; i != node.last; ++i) {
+      if (m_boids_ptr[i] != &boid) {
+        double dx = m_positions[i].x() - x;
+        double dy = m_positions[i].y() - y;
+        nearest.offer(dx * dx + dy * dy, m_boids_ptr[i]);
+      }
+    }
+  }
+
+  nearest.write(nearest_boids);
+}
+
+std::size_t Linear_quad_tree::memory_usage() const {
+  return m_nodes.capacity() * sizeof(Node) +
+         m_boids_ptr.capacity() * sizeof(const Boid*) +
+         m_codes.capacity() * sizeof(std::uint32_t) +
+         m_positions.capacity() * sizeof(Point) +
+         m_unsorted_codes.capacity() * sizeof(std::uint32_t) +
+         m_order.capacity() * sizeof(int) +
+         m_sort_buffer.capacity() * sizeof(int);
+}
+
+void Linear_quad_tree::cells(sf::VertexArray& lines) const {
+  for (const auto& node : m_nodes) {
+    append_cell(lines, node.boundary.x - node.boundary.w,
+                node.boundary.y - node.boundary.h, node.boundary.w * 2,
+                node.boundary.h * 2);
+  }
+}
+}  // namespace boids
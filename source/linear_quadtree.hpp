@@ -0,0 +1,155 @@
+// implementation of space partitioning by using a linear quad tree: boids are
+// sorted along the morton (z-order) curve, so that the boids of every cell are
+// contiguous in memory, and the cells are stored in a flat array.
+#ifndef LINEAR_QUADTREE_HPP
+#define LINEAR_QUADTREE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>  //for std::max
+#include <array>
+#include <cstddef>  //for std::size_t
+#include <cstdint>
+#include <vector>
+
+#include "boid.hpp"
+#include "constants.hpp"
+#include "point.hpp"
+#include "quadtree.hpp"
+
+namespace boids {
+
+// number of bits of each coordinate in a morton code
+inline constexpr int morton_bits{16};
+
+// returns the morton code of the provided point: the position inside the
+// rectangle is discretized on a grid of 2^morton_bits cells per side, and the
+// bits of the two grid coordinates are interleaved (x in the even bits, y in
+// the odd ones). points outside of the rectangle are clamped on its border.
+// Param 1: the point
+// Param 2: the rectangle
+std::uint32_t morton_code(const Point&, const Rectangle&);
+
+// reorders the boids by morton code, so boids that are close in space are
+// also close in memory. the first boid is left in place, since its ranges get
+// displayed by the gui. since update_vertices rewrites the vertices of every
+// boid at each step, the vertex array needs no reordering.
+// returns the order of the boids: the boid now at index i was at order[i].
+// Param 1: the vector of boids
+// Param 2: the rectangle used for the morton codes
+std::vector<int> spatial_sort(std::vector<Boid>&, const Rectangle&);
+
+class Linear_quad_tree {
+  // cell of the tree. the boids of a cell are the ones in [first, last) of
+  // the sorted arrays, the children (if any) are the child_count cells
+  // starting from first_child in m_nodes.
+  struct Node {
+    Rectangle boundary{};
+    // smallest box containing the boids of the cell. used in place of
+    // boundary to discard cells during query, it also includes the boids
+    // outside of the mother cell
+    double min_x{};
+    double min_y{};
+    double max_x{};
+    double max_y{};
+    int first{};
+    int last{};
+    int first_child{-1};
+    int child_count{};
+
+    // square of the distance between the point and the box of the cell, 0
+    // if the point is inside
+    double squared_distance(double x, double y) const {
+      double dx = std::max({min_x - x, 0., x - max_x});
+      double dy = std::max({min_y - y, 0., y - max_y});
+      return dx * dx + dy * dy;
+    }
+  };
+
+  // maximum number of boids in a leaf cell
+  int m_capacity{};
+  // maximum number of subdivisions, at most morton_bits
+  int m_max_depth{};
+
+  Rectangle m_boundary{};
+
+  std::vector<Node> m_nodes;
+
+  // boids sorted by morton code, their codes and a copy of their positions,
+  // so query() reads contiguous memory
+  std::vector<const Boid*> m_boids_ptr;
+  std::vector<std::uint32_t> m_codes;
+  std::vector<Point> m_positions;
+
+  // buffers for the radix sort, kept to avoid allocating at every build
+  std::vector<std::uint32_t> m_unsorted_codes;
+  std::vector<int> m_order;
+  std::vector<int> m_sort_buffer;
+
+  // cells still to visit during a search. each visit removes one cell and
+  // adds at most four, so the stack never exceeds 1 + 3 * morton_bits cells
+  using Stack = std::array<int, 1 + 3 * morton_bits>;
+
+  // sorts m_order by m_unsorted_codes
+  void sort();
+
+  // pushes the children of the provided cell on the stack, so that they are
+  // popped in morton order, or from the closest to the provided point
+  // Param 1: the cell
+  // Param 2: x of the point
+  // Param 3: y of the point
+  // Param 4: true to visit the closest children first
+  // Param 5: the stack
+  // Param 6: the size of the stack
+  void push_children(const Node&, double, double, bool, Stack&, int&) const;
+
+  // appends to m_nodes the children of the provided node, then recursively
+  // their children.
+  // Param 1: index of the node
+  // Param 2: depth of the node
+  void subdivide(int, int);
+
+ public:
+  // Param 1: m_capacity
+  // Param 2: m_boundary
+  // Param 3: m_max_depth
+  Linear_quad_tree(int, const Rectangle&, int = constants::max_tree_depth);
+
+  // changes the capacity used by the next build()
+  // Param 1: the capacity
+  void set_capacity(int);
+
+  // rebuilds the tree from the provided boids. the tree stores pointers to
+  // them, and copies of their positions at the time of the build.
+  // Param 1: the vector of boids
+  void build(const std::vector<Boid>&);
+
+  // populates the provided vector of boid pointers with pointers to boids
+  // contained within the tree that are within the specified range from the
+  // given boid (itself excluded). boids are added in morton order.
+  // if a maximum number of neighbours is given, the query stops as soon as
+  // the vector holds that many boids. cells are then visited from the closest
+  // to the boid, so the same boids are always selected for the same tree.
+  // Param 1: the range
+  // Param 2: the boid
+  // Param 3: the vector of boid pointers
+  // Param 4: maximum number of neighbours, 0 for no limit
+  void query(double, const Boid&, std::vector<const Boid*>&, int = 0) const;
+
+  // populates the provided vector of boid pointers with pointers to the k
+  // boids contained within the tree closest to the given boid (itself
+  // excluded), from the closest. fewer if the tree has fewer boids.
+  // Param 1: k
+  // Param 2: the boid
+  // Param 3: the vector of boid pointers
+  void k_nearest(int, const Boid&, std::vector<const Boid*>&) const;
+
+  // returns the number of bytes allocated by the tree
+  std::size_t memory_usage() const;
+
+  // appends the edges of the cells of the tree to the vertex array, see
+  // append_cell
+  // Param 1: the vertex array of lines
+  void cells(sf::VertexArray&) const;
+};
+}  // namespace boids
+#endif
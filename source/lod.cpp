@@ -0,0 +1,87 @@
+#include "lod.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>  //for std::max, std::max_element
+#include <cassert>
+#include <cmath>    //for std::ceil, std::log
+#include <cstddef>  //for std::size_t
+
+#include "constants.hpp"
+
+namespace boids {
+Detail choose_detail(double size, std::size_t bird_count, double pixel_size,
+                     std::size_t cell_count) {
+  assert(size > 0. && pixel_size > 0.);
+  if (size >= constants::triangle_min_pixels * pixel_size) {
+    return Detail::triangles;
+  }
+  // points cost one vertex per bird, the density six per cell at most
+  if (bird_count <= cell_count) {
+    return Detail::points;
+  }
+  return Detail::density;
+}
+
+std::size_t Density_grid::cell_count(const sf::FloatRect& area,
+                                     double cell_size) {
+  assert(cell_size > 0.);
+  auto columns = static_cast<std::size_t>(
+      std::max(std::ceil(area.width / cell_size), 0.));
+  auto rows = static_cast<std::size_t>(
+      std::max(std::ceil(area.height / cell_size), 0.));
+  return columns * rows;
+}
+
+void Density_grid::reset(const sf::FloatRect& area, double cell_size) {
+  assert(cell_size > 0.);
+  m_area = area;
+  m_cell_size = cell_size;
+  m_columns = static_cast<int>(std::max(std::ceil(area.width / cell_size), 0.));
+  m_rows = static_cast<int>(std::max(std::ceil(area.height / cell_size), 0.));
+  m_counts.assign(static_cast<std::size_t>(m_columns) * m_rows, 0);
+}
+
+int Density_grid::count(int column, int row) const {
+  assert(column >= 0 && column < m_columns && row >= 0 && row < m_rows);
+  return m_counts[row * m_columns + column];
+}
+
+int Density_grid::columns() const { return m_columns; }
+
+int Density_grid::rows() const { return m_rows; }
+
+void Density_grid::vertices(sf::VertexArray& vertices, sf::Color color) const {
+  vertices.setPrimitiveType(sf::Triangles);
+  vertices.clear();
+  if (m_counts.empty()) {
+    return;
+  }
+  int max_count = *std::max_element(m_counts.begin(), m_counts.end());
+
+  for (int row = 0; row != m_rows; ++row) {
+    for (int column = 0; column != m_columns; ++column) {
+      int cell_count = m_counts[row * m_columns + column];
+      if (cell_count == 0) {
+        continue;
+      }
+      double fraction =
+          max_count > 1 ? std::log(cell_count) / std::log(max_count) : 1.;
+      sf::Color cell_color = color;
+      cell_color.a = static_cast<sf::Uint8>(
+          constants::density_min_alpha +
+          (255. - constants::density_min_alpha) * fraction);
+
+      float left = m_area.left + column * m_cell_size;
+      float top = m_area.top + row * m_cell_size;
+      float right = left + m_cell_size;
+      float bottom = top + m_cell_size;
+      vertices.append(sf::Vertex(sf::Vector2f(left, top), cell_color));
+      vertices.append(sf::Vertex(sf::Vector2f(right, top), cell_color));
+      vertices.append(sf::Vertex(sf::Vector2f(right, bottom), cell_color));
+      vertices.append(sf::Vertex(sf::Vector2f(left, top), cell_color));
+      vertices.append(sf::Vertex(sf::Vector2f(right, bottom), cell_color));
+      vertices.append(sf::Vertex(sf::Vector2f(left, bottom), cell_color));
+    }
+  }
+}
+}  // namespace boids
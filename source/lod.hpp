@@ -0,0 +1,190 @@
+// level of detail of the birds. zoomed in, every bird in view is a triangle,
+// the others are not drawn at all; once a triangle gets smaller than a few
+// pixels, every bird in view is a single point; and once the birds in view
+// outnumber the cells of a grid of a few pixels over it, the flock is drawn
+// as the density of birds in each cell. the number of vertices drawn is then
+// bounded by the size of the window, whatever the number of birds.
+#ifndef LOD_HPP
+#define LOD_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <vector>
+
+#include "parallel.hpp"
+#include "point.hpp"
+#include "sfml.hpp"
+#include "world.hpp"
+
+namespace boids {
+
+enum class Detail { triangles, points, density };
+
+// returns the level of detail for a flock
+// Param 1: size of the birds
+// Param 2: number of birds
+// Param 3: width of a pixel of the window, in the units of the world
+// Param 4: number of cells of the density grid of the view
+Detail choose_detail(double, std::size_t, double, std::size_t);
+
+// number of birds in each cell of a grid of square cells, covering a
+// rectangle of the world
+class Density_grid {
+  sf::FloatRect m_area{};
+  double m_cell_size{1.};
+  int m_columns{0};
+  int m_rows{0};
+  std::vector<int> m_counts;
+
+ public:
+  // empties the grid and covers the rectangle with cells of the provided
+  // size
+  // Param 1: the rectangle
+  // Param 2: the size of the cells
+  void reset(const sf::FloatRect&, double);
+
+  // returns the number of cells of the grid that would cover the rectangle
+  // Param 1: the rectangle
+  // Param 2: the size of the cells
+  static std::size_t cell_count(const sf::FloatRect&, double);
+
+  // template function, so it can handle both boids and predators
+  // counts the birds in the cells. birds outside of the rectangle are not
+  // counted
+  // Param 1: vector of boids/predators
+  template <class T>
+  void add(const std::vector<T>& bird_vec) {
+    for (const auto& bird : bird_vec) {
+      double column = (bird.pos().x() - m_area.left) / m_cell_size;
+      double row = (bird.pos().y() - m_area.top) / m_cell_size;
+      if (column >= 0. && column < m_columns && row >= 0. && row < m_rows) {
+        ++m_counts[static_cast<int>(row) * m_columns +
+                   static_cast<int>(column)];
+      }
+    }
+  }
+
+  // returns the number of birds in a cell
+  // Param 1: column of the cell
+  // Param 2: row of the cell
+  int count(int, int) const;
+
+  int columns() const;
+  int rows() const;
+
+  // writes two triangles for each cell holding birds, in the provided color,
+  // more opaque the more birds the cell holds
+  // Param 1: the vertex array
+  // Param 2: the color
+  void vertices(sf::VertexArray&, sf::Color) const;
+};
+
+// template function, so it can handle both boids and predators
+// writes the indices, in increasing order, of the birds that can be seen in
+// the rectangle: the ones within the margin of it, e.g. the length of their
+// triangles. with previous positions, the birds are drawn between those and
+// the current ones, so the birds that were within the margin before the
+// step are kept too
+// Param 1: the indices
+// Param 2: vector of boids/predators
+// Param 3: the rectangle
+// Param 4: the margin
+// Param 5: the previous positions of the birds, or an empty vector
+// Param 6: the world, for the displacements across its edges
+template <class T>
+void visible_birds(std::vector<int>& visible, const std::vector<T>& bird_vec,
+                   const sf::FloatRect& area, double margin,
+                   const std::vector<Point>& previous, const World& world) {
+  assert(previous.empty() || previous.size() == bird_vec.size());
+  const double left = area.left - margin;
+  const double top = area.top - margin;
+  const double right = area.left + area.width + margin;
+  const double bottom = area.top + area.height + margin;
+  auto inside = [=](const Point& pos) {
+    return pos.x() >= left && pos.x() <= right && pos.y() >= top &&
+           pos.y() <= bottom;
+  };
+
+  // every chunk collects its own indices, then they are joined in order
+  const int size = static_cast<int>(bird_vec.size());
+  std::vector<std::vector<int>> chunk_visible(chunk_count(size));
+  parallel_chunks(size, [&](int chunk, int begin, int end) {
+    for (int i = begin; i != end; ++i) {
+      const Point pos = bird_vec[i].pos();
+      bool seen = inside(pos);
+      if (!seen && !previous.empty()) {
+        seen = inside(pos - world.displacement(pos, previous[i]));
+      }
+      if (seen) {
+        chunk_visible[chunk].push_back(i);
+      }
+    }
+  });
+  visible.clear();
+  for (const auto& indices : chunk_visible) {
+    visible.insert(visible.end(), indices.begin(), indices.end());
+  }
+}
+
+// template function, so it can handle both boids and predators
+// writes one point per bird with the provided indices
+// Param 1: the vertex array
+// Param 2: vector of boids/predators
+// Param 3: the indices of the birds
+// Param 4: the color of the boids/predators
+template <class T>
+void update_points(sf::VertexArray& vertices, const std::vector<T>& bird_vec,
+                   const std::vector<int>& shown, sf::Color color) {
+  vertices.setPrimitiveType(sf::Points);
+  vertices.resize(shown.size());
+  parallel_for(static_cast<int>(shown.size()), [&](int j) {
+    const Point pos = bird_vec[shown[j]].pos();
+    vertices[j] = sf::Vertex(sf::Vector2f(pos.x(), pos.y()), color);
+  });
+}
+
+// template function, so it can handle both boids and predators
+// writes the vertices of the birds with the provided level of detail:
+// triangles or points for the birds with the provided indices, or the
+// density of the grid, which gets reset and filled with all the birds.
+// returns the number of vertices per bird, 0 for the density
+// Param 1: the vertex array
+// Param 2: the level of detail the vertex array was last written with, set
+// to the provided one. triangles written over densities get their color back
+// even if the number of vertices is the same
+// Param 3: vector of boids/predators
+// Param 4: the indices of the birds drawn as triangles or points, see
+// visible_birds
+// Param 5: the level of detail
+// Param 6: the size of the boids/predators
+// Param 7: the color of the boids/predators
+// Param 8: the density grid
+// Param 9: the rectangle of the world covered by the grid
+// Param 10: the size of the cells of the grid
+template <class T>
+int update_detail_vertices(sf::VertexArray& vertices, Detail& written,
+                           const std::vector<T>& bird_vec,
+                           const std::vector<int>& shown, Detail detail,
+                           double size, sf::Color color, Density_grid& grid,
+                           const sf::FloatRect& area, double cell_size) {
+  const bool recolor = written != detail;
+  written = detail;
+  switch (detail) {
+    case Detail::triangles:
+      fit_vertices(vertices, shown.size(), color, recolor);
+      update_vertices(vertices, bird_vec, shown, size);
+      return 3;
+    case Detail::points:
+      update_points(vertices, bird_vec, shown, color);
+      return 1;
+    case Detail::density:
+      grid.reset(area, cell_size);
+      grid.add(bird_vec);
+      grid.vertices(vertices, color);
+      return 0;
+  }
+  return 0;
+}
+}  // namespace boids
+#endif
@@ -1,15 +1,44 @@
 #include <SFML/Graphics.hpp>
 #include <TGUI/TGUI.hpp>
-#include <algorithm>  //for for_each
+#include <algorithm>  //for for_each, std::min
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>  //for std::llround
+#include <condition_variable>
+#include <cstddef>    //for std::size_t
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>  //for std::shared_ptr
+#include <mutex>
+#include <optional>
 #include <random>     //for marsenne twister and uniform
+#include <stdexcept>  //for std::invalid_argument, std::runtime_error
+#include <string>
+#include <thread>
+#include <utility>  //for std::move
 
 #include "boid.hpp"
+#include "checkpoint.hpp"
+#include "config.hpp"
 #include "constants.hpp"
+#include "frame_export.hpp"
 #include "gui.hpp"
+#include "handles.hpp"
+#include "kd_tree.hpp"
+#include "linear_quadtree.hpp"
+#include "lod.hpp"
+#include "neighbours.hpp"
+#include "parallel.hpp"
 #include "point.hpp"
 #include "quadtree.hpp"
+#include "recording.hpp"
 #include "sfml.hpp"
+#include "spsc_queue.hpp"
 #include "statistics.hpp"
+#include "triple_buffer.hpp"
+#include "world.hpp"
 
 namespace boids {
 
@@ -23,70 +52,910 @@ double uniform(double a, double b, std::mt19937& mt) {
 }
 
 // template, to take both predators and boid types
+// changes the number of birds to the provided one, spawning or retiring only
+// the difference: the birds already flying keep their state and handles. new
+// birds are appended to the vector and generated in parallel, in blocks of
+// constants::spawn_block_size birds, each drawing from its own random stream
+// seeded by mt. birds are retired at random, see move_random_to_end.
 template <class T>
-void initialize_birds(std::vector<T>& bird_vec, sf::VertexArray& vertices,
-                      double swarm_n, sf::Color bird_color, std::mt19937& mt) {
-  bird_vec.clear();
-  vertices.clear();
-
-  for (int i = 0; i < swarm_n; ++i) {
-    // initializes boid within a margin from screen border and control panel
-    auto boid_position = boids::Point{
-        boids::uniform(constants::margin_size + constants::controls_width,
-                       constants::window_width - constants::margin_size, mt),
-        boids::uniform(constants::margin_size,
-                       constants::window_height - constants::margin_size, mt)};
-    auto boid_velocity =
-        boids::Point{boids::uniform(constants::min_rand_velocity,
-                                    constants::max_rand_velocity, mt),
-                     boids::uniform(constants::min_rand_velocity,
-                                    constants::max_rand_velocity, mt)};
-    bird_vec.push_back(T{boid_position, boid_velocity});
-
-    // append each vertex to the boid_vertex array
-    sf::Vertex v1(sf::Vector2f(boid_position.x(), boid_position.y()),
-                  bird_color);
-    sf::Vertex v2(sf::Vector2f(boid_position.x(), boid_position.y()),
-                  bird_color);
-    sf::Vertex v3(sf::Vector2f(boid_position.x(), boid_position.y()),
-                  bird_color);
-
-    vertices.append(v1);
-    vertices.append(v2);
-    vertices.append(v3);
+void resize_flock(std::vector<T>& bird_vec, Handles& handles, int swarm_n,
+                  const Config& config, std::mt19937& mt) {
+  assert(swarm_n >= 0);
+  int old_n = static_cast<int>(bird_vec.size());
+  if (swarm_n <= old_n) {
+    move_random_to_end(bird_vec, handles, old_n - swarm_n, mt);
+    bird_vec.resize(swarm_n);
+    handles.retire(old_n - swarm_n);
+    return;
+  }
+  bird_vec.resize(swarm_n);
+  handles.spawn(swarm_n - old_n);
+
+  const int new_n = swarm_n - old_n;
+  std::vector<std::mt19937::result_type> seeds(
+      (new_n + constants::spawn_block_size - 1) / constants::spawn_block_size);
+  for (auto& seed : seeds) {
+    seed = mt();
+  }
+
+  const World& world = config.world;
+  parallel_tasks(static_cast<int>(seeds.size()), [&](int block) {
+    std::mt19937 block_mt{seeds[block]};
+    const int begin = old_n + block * constants::spawn_block_size;
+    const int end = std::min(begin + constants::spawn_block_size, swarm_n);
+    for (int i = begin; i != end; ++i) {
+      // initializes boid within a margin from the borders of the world
+      auto boid_position = boids::Point{
+          boids::uniform(world.min_x + config.margin_size,
+                         world.min_x + world.width - config.margin_size,
+                         block_mt),
+          boids::uniform(world.min_y + config.margin_size,
+                         world.min_y + world.height - config.margin_size,
+                         block_mt)};
+      auto boid_velocity =
+          boids::Point{boids::uniform(constants::min_rand_velocity,
+                                      constants::max_rand_velocity, block_mt),
+                       boids::uniform(constants::min_rand_velocity,
+                                      constants::max_rand_velocity, block_mt)};
+      bird_vec[i] = T{boid_position, boid_velocity};
+    }
+  });
+}
+
+// template, to take both predators and boid types
+// copies the positions of the birds
+// Param 1: vector of boids/predators
+// Param 2: the positions
+template <class T>
+void save_positions(const std::vector<T>& bird_vec,
+                    std::vector<Point>& positions) {
+  positions.resize(bird_vec.size());
+  for (std::size_t i = 0; i != bird_vec.size(); ++i) {
+    positions[i] = bird_vec[i].pos();
+  }
+}
+
+// template, to take both predators and boid types
+// replaces the birds with the provided ones, e.g. read from a checkpoint.
+// handles are given again, in the order of the vector.
+template <class T>
+void restore_flock(std::vector<T>& bird_vec, Handles& handles,
+                   std::vector<T>&& restored) {
+  bird_vec = std::move(restored);
+  handles = Handles{};
+  handles.spawn(static_cast<int>(bird_vec.size()));
+}
+
+// template, to take any function finding the neighbours of a boid
+// updates the boid positions. their vertices are updated afterwards, by
+// update_vertices
+// Param 1: function filling the vector of neighbours of the boid with the
+// provided index
+// Param 2: vector of boids
+// Param 3: vector of predators
+// Param 4: separation range
+// Param 5: separation coefficent
+// Param 6: cohesion coefficent
+// Param 7: alignment coefficent
+// Param 8: prey range
+// Param 9: the configuration
+template <class Find_neighbours>
+void update_boids(Find_neighbours find_neighbours,
+                  std::vector<Boid>& boid_vector,
+                  std::vector<Predator>& predator_vector,
+                  double separation_range, double separation_coefficent,
+                  double cohesion_coefficent, double alignment_coefficent,
+                  double prey_range, const Config& config) {
+  std::vector<const Boid*> in_range;
+
+  for (int i = 0; i != static_cast<int>(boid_vector.size()); ++i) {
+    in_range.clear();
+    find_neighbours(i, in_range);
+
+    boid_vector[i].update(config.delta_t_boid, in_range, separation_range,
+                          separation_coefficent, cohesion_coefficent,
+                          alignment_coefficent, config);
+
+    // moves away boid from in range predators
+    for_each(predator_vector.begin(), predator_vector.end(),
+             [&, i](Predator& predator) {
+               boid_vector[i].repel(predator.pos(), prey_range,
+                                    config.predator_avoidance_coeff, config);
+             });
+  }
+}
+
+// what the simulation thread hands to the window after each step: all that
+// is drawn or shown of the step. frames go through a Triple_buffer, so their
+// memory is reused
+struct Frame {
+  // triangles, points or densities, see lod.hpp
+  sf::VertexArray boid_vertex{sf::Triangles};
+  sf::VertexArray predator_vertex{sf::Triangles};
+  // the level of detail of each vertex array
+  Detail boid_detail{Detail::triangles};
+  Detail predator_detail{Detail::triangles};
+  // displacements of the birds during the step, empty if the frames are
+  // not interpolated or the birds are drawn as densities
+  std::vector<sf::Vector2f> boid_motion;
+  std::vector<sf::Vector2f> predator_motion;
+  // when the step was due, in the schedule of the simulation thread
+  std::chrono::steady_clock::time_point time{};
+  // edges of the cells of the spatial index, only when they are displayed.
+  // frames share them until the index gets built again
+  std::shared_ptr<const sf::VertexArray> cells;
+  // the first boid, whose ranges may be displayed, and its displacement
+  // during the step, zero if the frames are not interpolated
+  std::optional<Boid> first_boid;
+  Point first_boid_motion{};
+  double mean_distance{};
+  double distance_stddev{};
+  double mean_speed{};
+  double speed_stddev{};
+  double steps_per_second{};
+};
+
+// parameters of the simulation sent by the window, numbered in the order
+// they were sent. the simulation thread applies the last block it received
+// between two steps, so a step never mixes the values of two blocks
+struct Parameter_block {
+  std::uint64_t version{};
+  Slider_values sliders{};
+  int boid_number{};
+  int predator_number{};
+};
+
+// inputs of the window, read by the simulation thread before each step
+struct Controls {
+  // the mouse repels the birds while pressed
+  bool mouse_pressed{false};
+  Point mouse_position{};
+  bool display_tree{false};
+  // what the camera shows, for the level of detail
+  sf::FloatRect visible_area{};
+  double pixel_size{1.};
+  // set by F5, cleared by the simulation thread once it has the request
+  bool write_checkpoint{false};
+};
+
+// plays the recording in the file without simulating: frames are decoded
+// straight into the vertex arrays. the slider moves through the frames, space
+// pauses the replay, comma and period step one frame backward and forward.
+// throws std::runtime_error if the file is not a valid recording
+// Param 1: path of the recording
+void replay(const std::string& path) {
+  Recording recording{path};
+  const Recording_header& header = recording.header();
+  const std::uint64_t frame_count = recording.frame_count();
+  if (frame_count == 0) {
+    throw std::runtime_error{path + " holds no frames"};
+  }
+  const World world{header.min_x, header.min_y, header.width, header.height,
+                    false};
+
+  sf::RenderWindow window;
+  window.create(
+      sf::VideoMode(constants::window_width, constants::window_height),
+      "boids!", sf::Style::Default);
+  window.setFramerateLimit(60);
+  tgui::GuiSFML gui{window};
+  Camera camera{world};
+
+  sf::VertexArray boid_vertex{sf::Triangles};
+  sf::VertexArray predator_vertex{sf::Triangles};
+  Bird_renderer boid_renderer{constants::vertex_buffer};
+  Bird_renderer predator_renderer{constants::vertex_buffer};
+
+  tgui::Label::Ptr frame_label = tgui::Label::create();
+  frame_label->getRenderer()->setTextColor(sf::Color::White);
+  frame_label->setPosition(constants::first_element_x_position,
+                           constants::first_element_y_position);
+  gui.add(frame_label);
+
+  tgui::Slider::Ptr frame_slider =
+      tgui::Slider::create(0, static_cast<float>(frame_count - 1));
+  frame_slider->setSize(constants::widget_width, constants::widget_height);
+  frame_slider->setPosition(constants::first_element_x_position,
+                            constants::first_element_y_position +
+                                2 * constants::gui_element_distance);
+  gui.add(frame_slider);
+
+  std::uint64_t frame{0};
+  // the frame on screen, none before the first one is decoded
+  std::optional<std::uint64_t> shown_frame;
+  // the value the slider was last set to. above 2^24 frames a float does not
+  // hold every index, so a move of the slider is told by its value changing,
+  // not by it differing from the frame
+  float slider_value{frame_slider->getValue()};
+  bool playing{true};
+
+  while (window.isOpen()) {
+    sf::Event event;
+    while (window.pollEvent(event)) {
+      gui.handleEvent(event);
+      if (event.type == sf::Event::Closed) window.close();
+      camera.handle_event(event, window);
+
+      if (event.type == sf::Event::KeyPressed) {
+        switch (event.key.code) {
+          case sf::Keyboard::Space:
+            playing = !playing;
+            break;
+          case sf::Keyboard::Comma:
+            playing = false;
+            frame = frame > 0 ? frame - 1 : 0;
+            break;
+          case sf::Keyboard::Period:
+            playing = false;
+            frame = std::min(frame + 1, frame_count - 1);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+    if (frame_slider->getValue() != slider_value) {
+      // the slider was moved
+      frame = std::min(
+          static_cast<std::uint64_t>(std::llround(frame_slider->getValue())),
+          frame_count - 1);
+    } else if (playing && frame + 1 < frame_count) {
+      ++frame;
+    }
+
+    // a paused replay decodes nothing
+    if (frame != shown_frame) {
+      const Recorded_frame& recorded = recording.frame(frame);
+      replay_vertices(recorded, header, boid_vertex, predator_vertex);
+      shown_frame = frame;
+      frame_slider->setValue(static_cast<float>(frame));
+      slider_value = frame_slider->getValue();
+      frame_label->setText("Frame " + std::to_string(frame + 1) + " of " +
+                           std::to_string(frame_count) + "\nStep " +
+                           std::to_string(recorded.step));
+    }
+
+    window.clear(sf::Color::Black);
+    window.setView(camera.view());
+    boid_renderer.draw(window, boid_vertex);
+    predator_renderer.draw(window, predator_vertex);
+    window.setView(window.getDefaultView());
+    gui.draw();
+    window.display();
   }
 }
 }  // namespace boids
 
-int main() {
+// the settings are the ones of constants.hpp, unless changed from the
+// command line: boid [--config file] [name=value...] [world width] [world
+// height]. see config.hpp. boid --checkpoint file resumes the simulation
+// saved in the file, with its settings, and boid --replay file plays a
+// recording.
+int main(int argc, char* argv[]) {
+  if (argc == 3 && std::string{argv[1]} == "--replay") {
+    try {
+      boids::replay(argv[2]);
+    } catch (const std::runtime_error& error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+    return 0;
+  }
+
+  // boid --export directory draws the simulation into files, without a
+  // window. the other arguments are read as usual, as if these two were not
+  // there
+  std::optional<std::string> export_directory;
+  if (argc >= 3 && std::string{argv[1]} == "--export") {
+    export_directory = argv[2];
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  boids::Config config{};
+  bool fixed_config{};
+  std::optional<boids::Checkpoint> checkpoint;
+  try {
+    if (argc >= 3 && std::string{argv[1]} == "--checkpoint") {
+      std::ifstream file{argv[2], std::ios::binary};
+      if (!file) {
+        throw std::runtime_error{std::string{"cannot open "} + argv[2]};
+      }
+      checkpoint = boids::read_checkpoint(file);
+      config = checkpoint->config;
+
+      // the settings that follow override the ones of the checkpoint
+      boids::read_arguments(argc - 2, argv + 2, config);
+      config.validate();
+    } else {
+      fixed_config = !boids::read_arguments(argc, argv, config);
+      config.validate();
+    }
+  } catch (const std::invalid_argument& error) {
+    std::cerr << error.what() << "\nusage: boid [--config file] "
+              << "[name=value...] [world width] [world height]\n"
+              << "       boid --checkpoint file [name=value...]\n"
+              << "       boid --replay file\n"
+              << "       boid --export directory [other arguments]\n";
+    return 1;
+  } catch (const std::runtime_error& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+  const boids::World& world = config.world;
+
   std::vector<boids::Boid> boid_vector;
   std::vector<boids::Predator> predator_vector;
 
-  // array of vertices of triangle of a boid.
-  // for each boid three vertices
-  sf::VertexArray boid_vertex{sf::Triangles};
+  // stable handles of the birds, kept through spawns, retirements and sorts
+  boids::Handles boid_handles;
+  boids::Handles predator_handles;
 
-  // array of vertices of triangle of a predator
-  // for each predator three vertices
-  sf::VertexArray predator_vertex{sf::Triangles};
+  // draw the vertex arrays, from vertex buffers if the driver supports them
+  boids::Bird_renderer boid_renderer{config.vertex_buffer};
+  boids::Bird_renderer predator_renderer{config.vertex_buffer};
 
   // seeded marsenne twister engine, for random positions/velocities of boids
   std::mt19937 mt{std::random_device{}()};
 
+  // clock measuring the time spent building the spatial index and filling
+  // the neighbour lists from it, used to tune its cell capacity
+  sf::Clock tree_clock;
+  boids::Capacity_tuner capacity_tuner{
+      config.cell_capacity, config.min_cell_capacity, config.max_cell_capacity,
+      config.capacity_step, config.tuner_sample_frames};
+
+  // the area where boids fly, it is the mother cell of the spatial indices
+  const boids::Rectangle world_rectangle{world.min_x + world.width / 2.,
+                                         world.min_y + world.height / 2.,
+                                         world.width / 2., world.height / 2.};
+
+  // the part of the world shown in the window
+  boids::Camera camera{world};
+
+  // linear quad tree and k-d tree, kept between frames to reuse their memory
+  boids::Linear_quad_tree linear_tree{config.cell_capacity, world_rectangle};
+  boids::Kd_tree kd_tree{config.cell_capacity};
+
+  // quad tree, rebuilt from scratch each time the spatial index is needed
+  std::optional<boids::Quad_tree> tree;
+
+  // neighbour lists, reused until the boids have moved too much
+  boids::Verlet_list verlet_list{config.verlet_skin, world};
+
+  // records the trajectories every record_period steps, if not 0
+  std::optional<boids::Recorder> recorder;
+  if (config.record_period > 0) {
+    try {
+      recorder.emplace(constants::recording_file, world, config.record_period);
+    } catch (const std::runtime_error& error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+  }
+
+  // number of steps done, used to sort the boids periodically
+  int step{0};
+
+  // resumes the simulation of the checkpoint. its sliders are set below
+  if (checkpoint) {
+    restore_flock(boid_vector, boid_handles, std::move(checkpoint->boids));
+    restore_flock(predator_vector, predator_handles,
+                  std::move(checkpoint->predators));
+    mt = checkpoint->mt;
+    step = static_cast<int>(checkpoint->step);
+  }
+
+  // real time of a step. the frames are interpolated only when the rate is
+  // limited, otherwise each one is shown as soon as possible. an export runs
+  // as fast as the frames are drawn, whatever the rate
+  using Steady_clock = std::chrono::steady_clock;
+  const bool limit_rate = !export_directory && config.simulation_rate > 0.;
+  const bool interpolate = limit_rate && config.interpolation;
+  Steady_clock::duration step_period{0};
+  if (limit_rate) {
+    step_period = std::chrono::duration_cast<Steady_clock::duration>(
+        std::chrono::duration<double>{1. / config.simulation_rate});
+  }
+
+  // state shared with the simulation thread: the frames it completes, the
+  // parameters and the other inputs of the window, and whether it should
+  // keep running
+  boids::Triple_buffer<boids::Frame> frames;
+  boids::Spsc_queue<boids::Parameter_block, constants::parameter_queue_size>
+      parameter_queue;
+  std::mutex controls_mutex;
+  boids::Controls controls;
+  std::atomic<bool> running{true};
+
+  // in an export every step is drawn: a frame is only published once the
+  // previous one has been taken, so that none is overwritten
+  std::mutex export_mutex;
+  std::condition_variable export_condition;
+  std::uint64_t published_frames{0};
+  std::uint64_t taken_frames{0};
+
+  // sends a new block of parameters. returns false if the queue is full, the
+  // block can then be sent again later. the window thread is the only
+  // producer: any other source of parameters goes through it
+  std::uint64_t parameter_version{0};
+  auto send_parameters = [&](const boids::Slider_values& sliders,
+                             int boid_number, int predator_number) {
+    boids::Parameter_block block{parameter_version + 1, sliders, boid_number,
+                                 predator_number};
+    if (!parameter_queue.push(block)) {
+      return false;
+    }
+    ++parameter_version;
+    return true;
+  };
+
+  // the simulation thread owns the birds, the spatial indices and the
+  // recorder until it is joined
+  auto simulation_loop = [&] {
+    boids::Controls step_controls;
+
+    // the parameters of the steps, replaced between steps by the last block
+    // received
+    boids::Parameter_block parameters;
+    boids::Parameter_block received;
+
+    // vectores to store distances and speed of the boids
+    std::vector<double> distances;
+    std::vector<double> speeds;
+
+    // edges of the cells of the spatial index, collected when the index is
+    // built and displayed, and kept while it does not change
+    std::shared_ptr<sf::VertexArray> cell_lines;
+    bool index_changed{true};
+
+    // counts the birds when they are drawn as densities
+    boids::Density_grid density_grid;
+
+    // indices of the birds in view, the only ones drawn as triangles or
+    // points
+    std::vector<int> shown_birds;
+
+    // positions of the birds before the step, for the interpolation
+    std::vector<boids::Point> previous_boid_positions;
+    std::vector<boids::Point> previous_predator_positions;
+
+    // clock for the steps per second
+    sf::Clock step_clock;
+
+    // real time not simulated yet. every step takes step_period from it, so
+    // that the model time follows the real one: the thread runs as many
+    // steps as are due, at most max_catch_up_steps in a row, then sleeps
+    // until the next one
+    auto last_time = Steady_clock::now();
+    Steady_clock::duration accumulator{0};
+
+    while (running) {
+      if (limit_rate) {
+        auto now = Steady_clock::now();
+        accumulator = std::min(accumulator + (now - last_time),
+                               constants::max_catch_up_steps * step_period);
+        last_time = now;
+        if (accumulator < step_period) {
+          std::this_thread::sleep_for(step_period - accumulator);
+          continue;
+        }
+        accumulator -= step_period;
+      } else {
+        last_time = Steady_clock::now();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock{controls_mutex};
+        step_controls = controls;
+        controls.write_checkpoint = false;
+      }
+
+      // the blocks sent during the last step are skipped but for the last one
+      while (parameter_queue.pop(received)) {
+        assert(received.version > parameters.version);
+        parameters = received;
+      }
+      const double separation_coefficent =
+          parameters.sliders.separation_coefficent;
+      const double cohesion_coefficent = parameters.sliders.cohesion_coefficent;
+      const double alignment_coefficent =
+          parameters.sliders.alignment_coefficent;
+      const double range = parameters.sliders.range;
+      const double separation_range = parameters.sliders.separation_range;
+      const double prey_range = parameters.sliders.prey_range;
+      const double predator_range = config.prey_to_predator_coeff * prey_range;
+
+      // if the value of the slider is changed, change number of boids
+      if (parameters.boid_number != static_cast<int>(boid_vector.size())) {
+        resize_flock(boid_vector, boid_handles, parameters.boid_number,
+                     config, mt);
+        verlet_list.invalidate();
+      }
+
+      // if the value of the slider is changed, change number of predators
+      if (parameters.predator_number !=
+          static_cast<int>(predator_vector.size())) {
+        resize_flock(predator_vector, predator_handles,
+                     parameters.predator_number, config, mt);
+      }
+
+      // saves the simulation, to resume it with boid --checkpoint
+      if (step_controls.write_checkpoint) {
+        std::ofstream file{constants::checkpoint_file, std::ios::binary};
+        try {
+          boids::write_checkpoint(file, config, parameters.sliders, step,
+                                  mt, boid_vector, predator_vector);
+          std::cout << "checkpoint written to " << constants::checkpoint_file
+                    << '\n';
+        } catch (const std::runtime_error& error) {
+          std::cerr << error.what() << '\n';
+        }
+      }
+
+      // updating positions of boids/predators  ////////////////////////////////
+
+      // the default settings are read through Fixed_config, so that the
+      // branches of the step on them get folded, see config.hpp
+      auto simulate = [&](const auto& settings) {
+        const boids::Config& step_config = settings.get();
+
+        // keeps boids that are close in space also close in memory
+        if (step_config.spatial_sort_period > 0 &&
+            step % step_config.spatial_sort_period == 0) {
+          boid_handles.reorder(
+              boids::spatial_sort(boid_vector, world_rectangle));
+          verlet_list.invalidate();
+        }
+        ++step;
+
+        if (interpolate) {
+          boids::save_positions(boid_vector, previous_boid_positions);
+          boids::save_positions(predator_vector, previous_predator_positions);
+        }
+
+        // neighbour lists are not used in topological mode
+        const bool use_verlet_list = step_config.verlet_skin > 0. &&
+                                     step_config.topological_neighbours == 0;
+
+        // the spatial index is only needed when the neighbour lists get
+        // rebuilt
+        const bool build_index =
+            !use_verlet_list || verlet_list.needs_rebuild(boid_vector, range);
+
+        // time spent building the index and querying it, the cost the
+        // capacity is tuned on. the rest of the step does not depend on the
+        // capacity, so it is left out
+        double index_seconds{0.};
+        Steady_clock::duration query_time{0};
+
+        if (build_index) {
+          index_changed = true;
+          tree_clock.restart();
+          switch (step_config.spatial_index) {
+            case constants::Spatial_index::quad_tree:
+              tree.emplace(capacity_tuner.capacity(), world_rectangle);
+              for (auto& boid : boid_vector) {
+                tree->insert(boid);
+              }
+              break;
+            case constants::Spatial_index::linear_quad_tree:
+              linear_tree.set_capacity(capacity_tuner.capacity());
+              linear_tree.build(boid_vector);
+              break;
+            case constants::Spatial_index::kd_tree:
+              kd_tree.set_capacity(capacity_tuner.capacity());
+              kd_tree.build(boid_vector);
+              break;
+          }
+          index_seconds = tree_clock.getElapsedTime().asSeconds();
+        }
+
+        // handles boid/predator repulsion
+        if (step_controls.mouse_pressed) {
+          const boids::Point& mouse_position = step_controls.mouse_position;
+          for (auto& boid : boid_vector) {
+            if (world.displacement(boid.pos(), mouse_position).distance() <
+                step_config.repel_range)
+              boid.repel(mouse_position, step_config.repel_range,
+                         step_config.repel_coefficent, step_config);
+          }
+
+          for (auto& predator : predator_vector) {
+            if (world.displacement(predator.pos(), mouse_position).distance() <
+                step_config.repel_range)
+              predator.repel(mouse_position, step_config.repel_range,
+                             step_config.repel_coefficent, step_config);
+          }
+        }
+
+        // updates the predator positions
+        for (int i = 0; i != static_cast<int>(predator_vector.size()); ++i) {
+          predator_vector[i].update(step_config.delta_t_predator,
+                                    predator_range, boid_vector, step_config);
+        }
+
+        // updates the boid positions, with the selected spatial index
+        auto update_with = [&](const auto& index) {
+          if (use_verlet_list && build_index) {
+            tree_clock.restart();
+            verlet_list.build(index, boid_vector, range);
+            index_seconds += tree_clock.getElapsedTime().asSeconds();
+          }
+
+          // fills the vector with the in range boids, or with the closest
+          // ones in topological mode
+          auto find_neighbours = [&](int i, std::vector<const boids::Boid*>&
+                                                in_range) {
+            if (step_config.topological_neighbours > 0) {
+              auto start = Steady_clock::now();
+              boids::periodic_k_nearest(index, world,
+                                        step_config.topological_neighbours,
+                                        boid_vector[i], in_range);
+              query_time += Steady_clock::now() - start;
+            } else if (use_verlet_list) {
+              // the lists were filled from the index, they do not query it
+              verlet_list.query(range, i, boid_vector, in_range,
+                                step_config.max_neighbours);
+            } else {
+              auto start = Steady_clock::now();
+              boids::periodic_query(index, world, range, boid_vector[i],
+                                    in_range, step_config.max_neighbours);
+              query_time += Steady_clock::now() - start;
+            }
+          };
+
+          boids::update_boids(find_neighbours, boid_vector, predator_vector,
+                              separation_range, separation_coefficent,
+                              cohesion_coefficent, alignment_coefficent,
+                              prey_range, step_config);
+        };
+        switch (step_config.spatial_index) {
+          case constants::Spatial_index::quad_tree:
+            update_with(*tree);
+            break;
+          case constants::Spatial_index::linear_quad_tree:
+            update_with(linear_tree);
+            break;
+          case constants::Spatial_index::kd_tree:
+            update_with(kd_tree);
+            break;
+        }
+
+        // the cost is taken per boid, so that changing the number of boids
+        // does not mislead the tuner. the capacity only matters when the
+        // index is built, so the other frames are not recorded
+        if (build_index && !boid_vector.empty()) {
+          index_seconds += std::chrono::duration<double>(query_time).count();
+          capacity_tuner.record(index_seconds / boid_vector.size());
+        }
+      };
+      if (fixed_config) {
+        simulate(boids::Fixed_config{});
+      } else {
+        simulate(boids::Runtime_config{config});
+      }
+
+      // fills the frame for the window ///////////////////////////////////////
+      boids::Frame& frame = frames.back();
+
+      // the vertices are generated in a separate pass, split between
+      // threads, with the level of detail fitting the zoom of the camera
+      const double cell_size =
+          constants::density_cell_pixels * step_controls.pixel_size;
+      const std::size_t cell_count = boids::Density_grid::cell_count(
+          step_controls.visible_area, cell_size);
+      auto update_flock = [&](sf::VertexArray& vertices,
+                              boids::Detail& written,
+                              std::vector<sf::Vector2f>& motion,
+                              const auto& bird_vec,
+                              const std::vector<boids::Point>& previous,
+                              double size, sf::Color color) {
+        // the tip of a triangle is twice the size ahead of the bird
+        boids::visible_birds(shown_birds, bird_vec, step_controls.visible_area,
+                             2. * size, previous, world);
+        boids::Detail detail = boids::choose_detail(
+            size, shown_birds.size(), step_controls.pixel_size, cell_count);
+        int per_bird = boids::update_detail_vertices(
+            vertices, written, bird_vec, shown_birds, detail, size, color,
+            density_grid, step_controls.visible_area, cell_size);
+        if (interpolate && per_bird > 0) {
+          boids::update_motion(motion, bird_vec, shown_birds, previous, world);
+        } else {
+          motion.clear();
+        }
+      };
+      update_flock(frame.boid_vertex, frame.boid_detail, frame.boid_motion,
+                   boid_vector, previous_boid_positions, constants::boid_size,
+                   constants::boid_color);
+      update_flock(frame.predator_vertex, frame.predator_detail,
+                   frame.predator_motion, predator_vector,
+                   previous_predator_positions, constants::predator_size,
+                   constants::predator_color);
+      // the time not simulated yet is the time since the step was due
+      frame.time = last_time - accumulator;
+
+      // only the current boids count, so the vectors are emptied every step
+      distances.clear();
+      speeds.clear();
+      for (const auto& boid : boid_vector) {
+        distances.push_back(boid.pos().distance());
+        speeds.push_back(boid.vel().distance());
+      }
+      frame.mean_distance = boids::calculate_mean_distance(boid_vector);
+      frame.distance_stddev =
+          boids::calculate_standard_deviation(distances, frame.mean_distance);
+      frame.mean_speed = boids::calculate_mean_speed(boid_vector);
+      frame.speed_stddev =
+          boids::calculate_standard_deviation(speeds, frame.mean_speed);
+
+      // the edges are collected again only when the index has changed. the
+      // lines still shared with frames are left to them
+      if (step_controls.display_tree) {
+        if (index_changed || !cell_lines) {
+          if (!cell_lines || cell_lines.use_count() > 1) {
+            cell_lines = std::make_shared<sf::VertexArray>(sf::Lines);
+          }
+          cell_lines->clear();
+          switch (config.spatial_index) {
+            case constants::Spatial_index::quad_tree:
+              if (tree) {
+                tree->cells(*cell_lines);
+              }
+              break;
+            case constants::Spatial_index::linear_quad_tree:
+              linear_tree.cells(*cell_lines);
+              break;
+            case constants::Spatial_index::kd_tree:
+              kd_tree.cells(*cell_lines);
+              break;
+          }
+          index_changed = false;
+        }
+        frame.cells = cell_lines;
+      } else {
+        frame.cells.reset();
+      }
+
+      if (boid_vector.empty()) {
+        frame.first_boid.reset();
+      } else {
+        frame.first_boid = boid_vector[0];
+        frame.first_boid_motion =
+            interpolate ? world.displacement(boid_vector[0].pos(),
+                                             previous_boid_positions[0])
+                        : boids::Point{};
+      }
+
+      frame.steps_per_second = 1. / step_clock.restart().asSeconds();
+      if (export_directory) {
+        std::unique_lock<std::mutex> lock{export_mutex};
+        export_condition.wait(lock, [&] {
+          return taken_frames == published_frames || !running;
+        });
+        frames.publish();
+        ++published_frames;
+        export_condition.notify_all();
+      } else {
+        frames.publish();
+      }
+
+      if (recorder) {
+        recorder->record(static_cast<std::uint64_t>(step), boid_vector,
+                         boid_handles, predator_vector, predator_handles);
+      }
+    }
+  };
+
+  // stops the simulation thread, then writes the frames still queued by the
+  // recorder
+  std::thread simulation_thread;
+  auto stop_simulation = [&] {
+    running = false;
+    simulation_thread.join();
+    if (recorder) {
+      if (!recorder->close()) {
+        std::cerr << "cannot write " << constants::recording_file << '\n';
+      }
+      if (recorder->dropped() > 0) {
+        std::cerr << recorder->dropped()
+                  << " frames were not recorded, the disk was too slow\n";
+      }
+    }
+  };
+
+  // draws the steps into files, without any window ///////////////////////////
+  if (export_directory) {
+    std::optional<boids::Frame_writer> writer;
+    try {
+      writer.emplace(*export_directory, config.raw_video);
+    } catch (const std::runtime_error& error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+
+    // the texture is the part of the window right of the panel, the view of
+    // the camera covers all of it
+    const auto width = static_cast<unsigned>(constants::window_width -
+                                             constants::controls_width);
+    const auto height = static_cast<unsigned>(constants::window_height);
+    sf::RenderTexture texture;
+    if (!texture.create(width, height)) {
+      std::cerr << "cannot create a texture of " << width << 'x' << height
+                << '\n';
+      return 1;
+    }
+    sf::View view = camera.view();
+    view.setViewport(sf::FloatRect(0.f, 0.f, 1.f, 1.f));
+    texture.setView(view);
+
+    // the birds and sliders of the checkpoint, or the initial ones
+    if (checkpoint) {
+      send_parameters(checkpoint->sliders,
+                      static_cast<int>(boid_vector.size()),
+                      static_cast<int>(predator_vector.size()));
+    } else {
+      send_parameters(boids::initial_slider_values(),
+                      constants::init_boid_number,
+                      constants::init_predator_number);
+    }
+    controls.visible_area = camera.visible_area();
+    controls.pixel_size = camera.pixel_size(sf::Vector2u(
+        static_cast<unsigned>(constants::window_width), height));
+    simulation_thread = std::thread{simulation_loop};
+
+    // each image is one step, and each step gets an image. the next step
+    // is simulated while the frame is drawn and copied from the graphics
+    // card, and the encoding overlaps with the next copies
+    int exported{0};
+    while (exported < config.export_frames) {
+      {
+        std::unique_lock<std::mutex> lock{export_mutex};
+        export_condition.wait(
+            lock, [&] { return taken_frames < published_frames; });
+        frames.update();
+        ++taken_frames;
+        export_condition.notify_all();
+      }
+      const boids::Frame& frame = frames.front();
+      texture.clear(sf::Color::Black);
+      boid_renderer.draw(texture, frame.boid_vertex);
+      predator_renderer.draw(texture, frame.predator_vertex);
+      texture.display();
+      writer->write(texture.getTexture().copyToImage());
+      ++exported;
+    }
+
+    // the simulation may be waiting for the next frame to be taken
+    {
+      std::lock_guard<std::mutex> lock{export_mutex};
+      running = false;
+    }
+    export_condition.notify_all();
+    stop_simulation();
+    if (!writer->close()) {
+      std::cerr << "cannot write the frames to " << *export_directory << '\n';
+      return 1;
+    }
+    std::cout << writer->written() << " frames written to "
+              << *export_directory << '\n';
+    return 0;
+  }
+
   // makes the window and specifies it's size and title
   sf::RenderWindow window;
   window.create(
       sf::VideoMode(constants::window_width, constants::window_height),
       "boids!", sf::Style::Default);
 
-  // lock framerate to 60 fps
+  // lock framerate to 60 fps. the simulation runs at its own rate, on its
+  // own thread
   window.setFramerateLimit(60);
 
   tgui::GuiSFML gui{window};
 
-  // vectores to store distances and speed of the boids
-  std::vector<double> distances;
-  std::vector<double> speeds;
   // creating the label to display all the stats
   tgui::Label::Ptr stats_label = tgui::Label::create();
   stats_label->getRenderer()->setTextColor(sf::Color::Black);
@@ -96,6 +965,11 @@ int main() {
   // clock for fps calculation
   sf::Clock clock;
 
+  // clock for the refresh of the statistics label, and the fps shown
+  sf::Clock stats_clock;
+  bool stats_due{true};
+  int shown_fps{-1};
+
   // booleans for gui buttons
   bool display_tree{false};
   bool display_range{false};
@@ -108,24 +982,63 @@ int main() {
                      constants::first_element_x_position,
                      constants::first_element_y_position);
 
+  // boid parameters and numbers of birds, written by the sliders when they
+  // move
+  boids::Panel_values panel_values;
+
   boids::initialize_panel(gui, panel, display_tree, display_range,
-                          display_separation_range, display_prey_range);
+                          display_separation_range, display_prey_range,
+                          panel_values, config);
 
   // bool for tracking if moused is pressed, for boid repulsion
   bool is_mouse_pressed{false};
 
-  // declaring boid parameters
-  double separation_coefficent{};
-  double cohesion_coefficent{};
-  double alignment_coefficent{};
-  double range{};
-  double separation_range{};
-  double prey_range{};
-  double predator_range{};
-
-  // initialize with absurd number so it automatically initializes boids
-  int boid_number{-1};
-  int predator_number{};
+  // bool for tracking if F5 was pressed since the last frame
+  bool checkpoint_requested{false};
+
+  // the sliders start from the checkpoint, so the numbers of birds read from
+  // them match the restored flocks
+  if (checkpoint) {
+    boids::set_panel(panel, checkpoint->sliders,
+                     static_cast<int>(boid_vector.size()),
+                     static_cast<int>(predator_vector.size()));
+    checkpoint.reset();
+  }
+
+  // the birds as drawn, between their positions of the last two steps
+  sf::VertexArray shown_boid_vertex{sf::Triangles};
+  sf::VertexArray shown_predator_vertex{sf::Triangles};
+
+  // hands the inputs to the simulation thread. the values of the panel are
+  // only sent when a slider has moved since the last time, and sent again
+  // if the queue was full
+  auto send_controls = [&] {
+    if (panel_values.changed &&
+        send_parameters(panel_values.sliders, panel_values.boid_number,
+                        panel_values.predator_number)) {
+      panel_values.changed = false;
+    }
+
+    // the mouse position in the world, as seen through the camera
+    sf::Vector2f mouse_coords = window.mapPixelToCoords(
+        sf::Mouse::getPosition(window), camera.view());
+
+    std::lock_guard<std::mutex> lock{controls_mutex};
+    controls.mouse_pressed = is_mouse_pressed;
+    controls.mouse_position = boids::Point(mouse_coords.x, mouse_coords.y);
+    controls.display_tree = display_tree;
+    controls.visible_area = camera.visible_area();
+    controls.pixel_size = camera.pixel_size(window.getSize());
+    if (checkpoint_requested) {
+      controls.write_checkpoint = true;
+      checkpoint_requested = false;
+    }
+  };
+
+  // the first controls are sent before the simulation starts, so that it
+  // spawns the birds of the sliders
+  send_controls();
+  simulation_thread = std::thread{simulation_loop};
 
   // SFML loop. After each loop the window is updated
   while (window.isOpen()) {
@@ -133,27 +1046,6 @@ int main() {
     auto current_time = clock.restart().asSeconds();
     double fps = 1. / (current_time);
 
-    for (const auto& boid : boid_vector) {
-      distances.push_back(boid.pos().distance());
-      speeds.push_back(boid.vel().distance());
-    }
-    double mean_distance = boids::calculate_mean_distance(boid_vector);
-    double distance_stddev =
-        boids::calculate_standard_deviation(distances, mean_distance);
-    double mean_speed = boids::calculate_mean_speed(boid_vector);
-    double speed_stddev =
-        boids::calculate_standard_deviation(speeds, mean_speed);
-    stats_label->setText(
-        "Mean distance: " + std::to_string(mean_distance) +
-        "\nStd Dev of distances: " + std::to_string(distance_stddev) +
-        "\nMean Velocity: " + std::to_string(mean_speed) +
-        "\nStd Dev of velocities: " + std::to_string(speed_stddev));
-
-    float label_width = stats_label->getSize().x;
-    float x_offset = window.getSize().x - label_width - 10;
-    float y_offset = 10;
-    stats_label->setPosition(x_offset, y_offset);
-
     sf::Event event;
 
     // if some input is given:
@@ -171,107 +1063,103 @@ int main() {
       if (event.type == sf::Event::MouseButtonReleased) {
         is_mouse_pressed = false;
       }
-    }
 
-    // updating game from GUI  /////////////////////////////////////////////////
-    // update the value of boid parameters based on the slider values
-    boids::update_from_panel(panel, fps, cohesion_coefficent,
-                             alignment_coefficent, separation_coefficent, range,
-                             separation_range, prey_range);
-    predator_range = constants::prey_to_predator_coeff * prey_range;
-
-    // if the value of the slider is changed, change number of boids
-    if (boids::update_boid_number(boid_number, panel)) {
-      initialize_birds(boid_vector, boid_vertex, boid_number,
-                       constants::boid_color, mt);
-    }
+      camera.handle_event(event, window);
 
-    // if the value of the slider is changed, change number of predators
-    if (boids::update_predator_number(predator_number, panel)) {
-      initialize_birds(predator_vector, predator_vertex, predator_number,
-                       constants::predator_color, mt);
+      // the checkpoint is written by the simulation thread, between steps
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::F5) {
+        checkpoint_requested = true;
+      }
     }
 
-    // updating positions of boids/predators  //////////////////////////////////
+    // updating game from GUI  /////////////////////////////////////////////////
+    boids::update_fps(panel, shown_fps, fps);
+    send_controls();
 
-    // quad tree object, partitions space improving performance
-    boids::Quad_tree tree{
-        constants::cell_capacity,
-        boids::Rectangle{
-            (constants::window_width + constants::controls_width) / 2.,
-            constants::window_height / 2.,
-            (constants::window_width - constants::controls_width) / 2.,
-            constants::window_height / 2.}};
+    // takes the last step completed by the simulation thread, or keeps
+    // showing the previous one
+    bool new_frame = frames.update();
+    const boids::Frame& frame = frames.front();
 
-    for (auto& boid : boid_vector) {
-      tree.insert(boid);
+    // the label is rewritten with the statistics of a new step, every
+    // stats_refresh_period at most
+    if (stats_clock.getElapsedTime().asSeconds() >=
+        constants::stats_refresh_period) {
+      stats_due = true;
     }
-
-    // handles boid/predator repulsion
-    if (is_mouse_pressed) {
-      boids::Point mouse_position(sf::Mouse::getPosition(window).x,
-                                  sf::Mouse::getPosition(window).y);
-      for (auto& boid : boid_vector) {
-        if ((boid.pos() - mouse_position).distance() < constants::repel_range)
-          boid.repel(mouse_position, constants::repel_range,
-                     constants::repel_coefficent);
-      }
-
-      for (auto& predator : predator_vector) {
-        if ((predator.pos() - mouse_position).distance() <
-            constants::repel_range)
-          predator.repel(mouse_position, constants::repel_range,
-                         constants::repel_coefficent);
-      }
+    if (new_frame && stats_due) {
+      stats_label->setText(
+          "Mean distance: " + std::to_string(frame.mean_distance) +
+          "\nStd Dev of distances: " + std::to_string(frame.distance_stddev) +
+          "\nMean Velocity: " + std::to_string(frame.mean_speed) +
+          "\nStd Dev of velocities: " + std::to_string(frame.speed_stddev) +
+          "\nSteps per second: " + std::to_string(frame.steps_per_second));
+      stats_clock.restart();
+      stats_due = false;
     }
 
-    // updates the predator positions
-    for (int i = 0; i != static_cast<int>(predator_vector.size()); ++i) {
-      predator_vector[i].update(constants::delta_t_predator, predator_range,
-                                boid_vector);
-      boids::vertex_update(predator_vertex, predator_vector[i], i,
-                           constants::predator_size);
-    }
-
-    // updates the boid positions
-    for (int i = 0; i != static_cast<int>(boid_vector.size()); ++i) {
-      std::vector<const boids::Boid*> in_range;
-
-      // tree builds the vector of in range boids
-      tree.query(range, boid_vector[i], in_range);
-
-      boid_vector[i].update(constants::delta_t_boid, in_range, separation_range,
-                            separation_coefficent, cohesion_coefficent,
-                            alignment_coefficent);
-
-      // moves away boid from in range predators
-      for_each(predator_vector.begin(), predator_vector.end(),
-               [&, i](boids::Predator& predator) {
-                 boid_vector[i].repel(predator.pos(), prey_range,
-                                      constants::predator_avoidance_coeff);
-               });
-
-      boids::vertex_update(boid_vertex, boid_vector[i], i,
-                           constants::boid_size);
-    }
+    float label_width = stats_label->getSize().x;
+    float x_offset = window.getSize().x - label_width - 10;
+    float y_offset = 10;
+    stats_label->setPosition(x_offset, y_offset);
 
     // drawing objects to window ///////////////////////////////////////////////
 
     // makes the window return black
     window.clear(sf::Color::Black);
 
-    window.draw(boid_vertex);
-    window.draw(predator_vertex);
+    // the world is drawn through the camera, the gui over the whole window
+    window.setView(camera.view());
+
+    // fraction of the way from the previous positions of the birds to the
+    // last ones: the birds are drawn one step late, moving smoothly from
+    // one step to the next
+    double fraction{1.};
+    if (interpolate) {
+      fraction = std::clamp(
+          std::chrono::duration<double>(Steady_clock::now() - frame.time) /
+              step_period,
+          0., 1.);
+    }
+    auto draw_flock = [&](boids::Bird_renderer& renderer,
+                          sf::VertexArray& shown,
+                          const sf::VertexArray& vertices,
+                          const std::vector<sf::Vector2f>& motion) {
+      if (motion.empty()) {
+        renderer.draw(window, vertices);
+      } else {
+        boids::interpolate_vertices(shown, vertices, motion, fraction);
+        renderer.draw(window, shown);
+      }
+    };
+    draw_flock(boid_renderer, shown_boid_vertex, frame.boid_vertex,
+               frame.boid_motion);
+    draw_flock(predator_renderer, shown_predator_vertex,
+               frame.predator_vertex, frame.predator_motion);
 
-    // if the show cells button is pressed the tree object is displayed
-    if (display_tree) tree.display(window);
+    // if the show cells button is pressed the cells of the spatial index are
+    // displayed, all in one draw call
+    if (display_tree && frame.cells) {
+      window.draw(*frame.cells);
+    }
 
     // if corresponding button is pressed, displays the ranges of the first boid
     // in the vector
-    boids::display_ranges(range, separation_range, prey_range, display_range,
-                          display_separation_range, display_prey_range,
-                          boid_vector, window);
+    if (frame.first_boid) {
+      boids::Boid shown_boid{frame.first_boid->pos() -
+                                 (1. - fraction) * frame.first_boid_motion,
+                             frame.first_boid->vel()};
+      const boids::Slider_values& sliders = panel_values.sliders;
+      boids::display_ranges(sliders.range, sliders.separation_range,
+                            sliders.prey_range, display_range,
+                            display_separation_range, display_prey_range,
+                            shown_boid, window);
+    }
+    window.setView(window.getDefaultView());
     gui.draw();
     window.display();
   }
-}
\ No newline at end of file
+
+  stop_simulation();
+}
@@ -0,0 +1,69 @@
+#include "mapped_file.hpp"
+
+#include <cstddef>  //for std::size_t
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BOIDS_MMAP
+#include <fcntl.h>     //for open
+#include <sys/mman.h>  //for mmap, munmap
+#include <sys/stat.h>  //for fstat
+#include <unistd.h>    //for close
+#endif
+
+namespace boids {
+Mapped_file::Mapped_file(const std::string& path) {
+#ifdef BOIDS_MMAP
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor == -1) {
+    throw std::runtime_error{"cannot open " + path};
+  }
+  struct stat status {};
+  if (::fstat(descriptor, &status) == -1) {
+    ::close(descriptor);
+    throw std::runtime_error{"cannot read " + path};
+  }
+  m_size = static_cast<std::size_t>(status.st_size);
+
+  // the mapping stays valid once the file is closed
+  if (m_size != 0) {
+    void* mapping =
+        ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(descriptor);
+      throw std::runtime_error{"cannot map " + path};
+    }
+    m_data = static_cast<const char*>(mapping);
+    m_mapped = true;
+  }
+  ::close(descriptor);
+#else
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) {
+    throw std::runtime_error{"cannot open " + path};
+  }
+  m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  if (!file) {
+    throw std::runtime_error{"cannot read " + path};
+  }
+  m_size = m_buffer.size();
+  m_data = m_size != 0 ? m_buffer.data() : nullptr;
+#endif
+}
+
+Mapped_file::~Mapped_file() {
+#ifdef BOIDS_MMAP
+  if (m_mapped) {
+    ::munmap(const_cast<char*>(m_data), m_size);
+  }
+#endif
+}
+
+const char* Mapped_file::data() const { return m_data; }
+
+std::size_t Mapped_file::size() const { return m_size; }
+}  // namespace boids
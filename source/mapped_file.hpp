@@ -0,0 +1,37 @@
+// read only view of a whole file. on posix systems the file is mapped in
+// memory, so only the pages that get read are loaded from the disk and the
+// operating system can drop them again when memory is short. elsewhere the
+// file is read at once.
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>  //for std::size_t
+#include <string>
+#include <vector>
+
+namespace boids {
+class Mapped_file {
+  const char* m_data{nullptr};
+  std::size_t m_size{0};
+  // true if m_data is a mapping, false if it points into m_buffer
+  bool m_mapped{false};
+  std::vector<char> m_buffer;
+
+ public:
+  // maps the file. throws std::runtime_error if it cannot be read
+  // Param 1: path of the file
+  explicit Mapped_file(const std::string&);
+
+  ~Mapped_file();
+
+  Mapped_file(const Mapped_file&) = delete;
+  Mapped_file& operator=(const Mapped_file&) = delete;
+
+  // returns the content of the file, nullptr if it is empty
+  const char* data() const;
+
+  // returns the size of the file in bytes
+  std::size_t size() const;
+};
+}  // namespace boids
+#endif
@@ -0,0 +1,103 @@
+#include "neighbours.hpp"
+
+#include <algorithm>  //for std::push_heap, std::pop_heap, std::sort_heap
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "boid.hpp"
+#include "point.hpp"
+#include "world.hpp"
+
+namespace boids {
+Nearest_boids::Nearest_boids(int k) : m_k{k} {
+  assert(k >= 0);
+  m_heap.reserve(k);
+}
+
+double Nearest_boids::worst() const {
+  if (static_cast<int>(m_heap.size()) < m_k) {
+    return std::numeric_limits<double>::infinity();
+  }
+  // with k = 0 nothing can be kept
+  return m_k == 0 ? -1. : m_heap.front().first;
+}
+
+void Nearest_boids::offer(double squared_distance, const Boid* boid_ptr) {
+  assert(boid_ptr);
+  if (static_cast<int>(m_heap.size()) < m_k) {
+    m_heap.emplace_back(squared_distance, boid_ptr);
+    std::push_heap(m_heap.begin(), m_heap.end());
+  } else if (m_k != 0 && squared_distance < m_heap.front().first) {
+    // replaces the farthest boid
+    std::pop_heap(m_heap.begin(), m_heap.end());
+    m_heap.back() = {squared_distance, boid_ptr};
+    std::push_heap(m_heap.begin(), m_heap.end());
+  }
+}
+
+void Nearest_boids::write(std::vector<const Boid*>& nearest) {
+  std::sort_heap(m_heap.begin(), m_heap.end());
+  for (const auto& [squared_distance, boid_ptr] : m_heap) {
+    nearest.push_back(boid_ptr);
+  }
+  m_heap.clear();
+}
+
+Verlet_list::Verlet_list(double skin, const World& world)
+    : m_skin{skin}, m_world{world} {
+  assert(skin >= 0.);
+}
+
+bool Verlet_list::needs_rebuild(const std::vector<Boid>& boid_vec,
+                                double range) const {
+  if (m_range < 0. || range != m_range ||
+      boid_vec.size() != m_positions.size()) {
+    return true;
+  }
+
+  double squared_limit = m_skin * m_skin / 4.;
+  for (int i = 0; i != static_cast<int>(boid_vec.size()); ++i) {
+    // boids that wrapped around the world have moved by a short distance
+    Point displacement =
+        m_world.displacement(boid_vec[i].pos(), m_positions[i]);
+    if (displacement.x() * displacement.x() +
+            displacement.y() * displacement.y() >
+        squared_limit) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Verlet_list::invalidate() { m_range = -1.; }
+
+void Verlet_list::query(double range, int index,
+                        const std::vector<Boid>& boid_vec,
+                        std::vector<const Boid*>& in_range,
+                        int max_neighbours) const {
+  assert(range <= m_range);
+  assert(index >= 0 && index + 1 < static_cast<int>(m_offsets.size()));
+  assert(max_neighbours >= 0);
+
+  const Point& pos = boid_vec[index].pos();
+  for (int j = m_offsets[index]; j != m_offsets[index + 1]; ++j) {
+    const Boid& other_boid = boid_vec[m_neighbours[j]];
+    if (m_world.displacement(other_boid.pos(), pos).distance() < range) {
+      if (max_neighbours != 0 &&
+          static_cast<int>(in_range.size()) >= max_neighbours) {
+        return;
+      }
+      in_range.push_back(&other_boid);
+    }
+  }
+}
+
+std::size_t Verlet_list::memory_usage() const {
+  return m_offsets.capacity() * sizeof(int) +
+         m_neighbours.capacity() * sizeof(int) +
+         m_positions.capacity() * sizeof(Point);
+}
+}  // namespace boids
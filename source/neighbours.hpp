@@ -0,0 +1,214 @@
+// helpers shared by the spatial indices to collect the neighbours of a boid.
+#ifndef NEIGHBOURS_HPP
+#define NEIGHBOURS_HPP
+
+#include <algorithm>  //for std::sort, std::unique
+#include <array>
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <utility>  //for std::pair
+#include <vector>
+
+#include "boid.hpp"
+#include "parallel.hpp"
+#include "point.hpp"
+#include "world.hpp"
+
+namespace boids {
+
+// keeps the k closest boids offered so far, in a max heap on their distance,
+// so the farthest one can be replaced in logarithmic time. used by the
+// k_nearest methods of the spatial indices.
+class Nearest_boids {
+  int m_k{};
+  std::vector<std::pair<double, const Boid*>> m_heap;
+
+ public:
+  // Param 1: k, the number of boids to keep
+  explicit Nearest_boids(int);
+
+  // returns the squared distance a boid must be closer than to be kept:
+  // infinity while fewer than k boids have been offered. cells farther than
+  // this can be skipped.
+  double worst() const;
+
+  // keeps the boid if it is among the k closest so far
+  // Param 1: squared distance of the boid
+  // Param 2: the boid
+  void offer(double, const Boid*);
+
+  // appends the kept boids to the provided vector, from the closest
+  // Param 1: the vector of boid pointers
+  void write(std::vector<const Boid*>&);
+};
+
+// template, to take any spatial index with a query method
+// like the query method of the index, but in a toroidal world it also finds
+// the boids within range across the edges, by querying the periodic images
+// of the boid.
+// Param 1: the spatial index
+// Param 2: the world
+// Param 3: the range
+// Param 4: the boid
+// Param 5: the vector of boid pointers
+// Param 6: maximum number of neighbours, 0 for no limit
+template <class Index>
+void periodic_query(const Index& index, const World& world, double range,
+                    const Boid& boid, std::vector<const Boid*>& in_range,
+                    int max_neighbours = 0) {
+  std::array<Point, 4> images;
+  int image_count = world.images(boid.pos(), range, images);
+  index.query(range, boid, in_range, max_neighbours);
+
+  // the boid is farther than the range from its own images, so it cannot be
+  // found through them
+  for (int i = 1; i != image_count; ++i) {
+    index.query(range, Boid{images[i], boid.vel()}, in_range, max_neighbours);
+  }
+}
+
+// template, to take any spatial index with a k_nearest method
+// like the k_nearest method of the index, but in a toroidal world it also
+// finds the boids across the edges, within half the shorter side of the
+// world.
+// Param 1: the spatial index
+// Param 2: the world
+// Param 3: k
+// Param 4: the boid
+// Param 5: the vector of boid pointers
+template <class Index>
+void periodic_k_nearest(const Index& index, const World& world, int k,
+                        const Boid& boid,
+                        std::vector<const Boid*>& nearest_boids) {
+  std::array<Point, 4> images;
+  int image_count = world.images(
+      boid.pos(), std::min(world.width, world.height) / 2., images);
+  if (image_count == 1) {
+    index.k_nearest(k, boid, nearest_boids);
+    return;
+  }
+
+  // the k nearest boids of every image, merged by their distance on the
+  // torus. a boid may be found from more than one image. an image is not
+  // the boid itself, so the index may return the boid among the nearest to
+  // the image: one more is asked for, so that k others are still found
+  std::vector<const Boid*> candidates;
+  index.k_nearest(k, boid, candidates);
+  for (int i = 1; i != image_count; ++i) {
+    index.k_nearest(k + 1, Boid{images[i], boid.vel()}, candidates);
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+
+  Nearest_boids nearest{k};
+  for (auto boid_ptr : candidates) {
+    if (boid_ptr != &boid) {
+      Point difference = world.displacement(boid_ptr->pos(), boid.pos());
+      nearest.offer(difference.x() * difference.x() +
+                        difference.y() * difference.y(),
+                    boid_ptr);
+    }
+  }
+  nearest.write(nearest_boids);
+}
+
+// verlet neighbour lists: the neighbours of every boid within range + skin,
+// found with a spatial index and then reused for several steps. as long as no
+// boid has moved more than skin / 2 since the lists were built, no pair of
+// boids can have come within range without being in the lists, so the
+// spatial index is needed only when the lists get rebuilt.
+class Verlet_list {
+  double m_skin{};
+  World m_world{};
+
+  // range the lists were built for, negative if they must be rebuilt
+  double m_range{-1.};
+
+  // the neighbours of boid i are the boids whose indices are in
+  // [m_offsets[i], m_offsets[i + 1]) of m_neighbours
+  std::vector<int> m_offsets;
+  std::vector<int> m_neighbours;
+
+  // positions of the boids when the lists were built
+  std::vector<Point> m_positions;
+
+ public:
+  // Param 1: the skin
+  // Param 2: the world, lists include the boids across its edges if toroidal
+  explicit Verlet_list(double, const World& = World{});
+
+  // returns true if the lists must be rebuilt: the number of boids or the
+  // range changed, or some boid moved more than skin / 2 since the build
+  // Param 1: vector of boids
+  // Param 2: the range
+  bool needs_rebuild(const std::vector<Boid>&, double) const;
+
+  // forces the next needs_rebuild() to return true. to be called when the
+  // boids get reordered or replaced
+  void invalidate();
+
+  // template, to take any spatial index with a query method
+  // builds the lists, querying the index with range + skin. the boids are
+  // split between threads.
+  // Param 1: the spatial index, built on the boid vector
+  // Param 2: vector of boids
+  // Param 3: the range
+  template <class Index>
+  void build(const Index& index, const std::vector<Boid>& boid_vec,
+             double range) {
+    assert(range >= 0.);
+    int size = static_cast<int>(boid_vec.size());
+
+    // each chunk of boids fills its own lists, merged afterwards in order
+    std::vector<std::vector<int>> chunk_offsets(chunk_count(size));
+    std::vector<std::vector<int>> chunk_neighbours(chunk_count(size));
+    parallel_chunks(size, [&](int chunk, int begin, int end) {
+      std::vector<const Boid*> in_range;
+      for (int i = begin; i != end; ++i) {
+        chunk_offsets[chunk].push_back(
+            static_cast<int>(chunk_neighbours[chunk].size()));
+        in_range.clear();
+        periodic_query(index, m_world, range + m_skin, boid_vec[i], in_range);
+        for (auto boid_ptr : in_range) {
+          chunk_neighbours[chunk].push_back(
+              static_cast<int>(boid_ptr - boid_vec.data()));
+        }
+      }
+    });
+
+    m_offsets.clear();
+    m_neighbours.clear();
+    for (int chunk = 0; chunk != static_cast<int>(chunk_offsets.size());
+         ++chunk) {
+      int shift = static_cast<int>(m_neighbours.size());
+      for (int offset : chunk_offsets[chunk]) {
+        m_offsets.push_back(offset + shift);
+      }
+      m_neighbours.insert(m_neighbours.end(), chunk_neighbours[chunk].begin(),
+                          chunk_neighbours[chunk].end());
+    }
+    m_offsets.push_back(static_cast<int>(m_neighbours.size()));
+
+    m_positions.resize(size);
+    for (int i = 0; i != size; ++i) {
+      m_positions[i] = boid_vec[i].pos();
+    }
+    m_range = range;
+  }
+
+  // populates the provided vector of boid pointers with pointers to the boids
+  // in the list of the provided boid that are within the specified range.
+  // Param 1: the range
+  // Param 2: index of the boid in the vector
+  // Param 3: vector of boids
+  // Param 4: the vector of boid pointers
+  // Param 5: maximum number of neighbours, 0 for no limit
+  void query(double, int, const std::vector<Boid>&, std::vector<const Boid*>&,
+             int = 0) const;
+
+  // returns the number of bytes allocated by the lists
+  std::size_t memory_usage() const;
+};
+}  // namespace boids
+#endif
@@ -0,0 +1,215 @@
+// helpers to split loops over boids between threads.
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>  //for std::min, std::max
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>  //for std::move
+#include <vector>
+
+#include "constants.hpp"
+
+namespace boids {
+
+// number of chunks a loop of the provided size gets split into by
+// parallel_chunks. it is one for loops shorter than
+// constants::min_parallel_size, where handing chunks to other threads would
+// cost more than the loop itself, and at most the number of hardware threads.
+// Param 1: the size of the loop
+inline int chunk_count(int size) {
+  int threads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  return std::max(1, std::min(threads, size / constants::min_parallel_size));
+}
+
+// threads kept waiting for tasks, so that parallel loops do not start and
+// join threads every time. the threads calling parallel_chunks take part in
+// the work while they wait for their chunks, which keeps nested or
+// concurrent loops from waiting on each other.
+class Thread_pool {
+  std::mutex m_mutex;
+  // signals new tasks, and the end of the pool, to the workers
+  std::condition_variable m_condition;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_stopping{false};
+  std::vector<std::thread> m_workers;
+
+ public:
+  // starts the workers
+  // Param 1: the number of workers
+  explicit Thread_pool(int workers) {
+    assert(workers >= 0);
+    m_workers.reserve(workers);
+    for (int i = 0; i != workers; ++i) {
+      m_workers.emplace_back([this] {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (true) {
+          m_condition.wait(lock,
+                           [this] { return m_stopping || !m_tasks.empty(); });
+          if (m_tasks.empty()) {
+            return;
+          }
+          auto task = std::move(m_tasks.front());
+          m_tasks.pop_front();
+          lock.unlock();
+          task();
+          lock.lock();
+        }
+      });
+    }
+  }
+
+  // runs the queued tasks, then joins the workers
+  ~Thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  Thread_pool(const Thread_pool&) = delete;
+  Thread_pool& operator=(const Thread_pool&) = delete;
+
+  // queues a task. tasks must not throw
+  // Param 1: the task
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+  }
+
+  // runs a queued task on the calling thread. returns false if there was none
+  bool run_one() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_tasks.empty()) {
+      return false;
+    }
+    auto task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    lock.unlock();
+    task();
+    return true;
+  }
+};
+
+// returns the pool of parallel_chunks, started on first use with a worker
+// per hardware thread but one, the calling thread being the last
+inline Thread_pool& thread_pool() {
+  static Thread_pool pool{
+      std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1)};
+  return pool;
+}
+
+// template function, so it can take any callable.
+// calls function(task) for each task in [0, tasks), the calling thread taking
+// the first one and the workers of thread_pool() the others. tasks may start
+// parallel tasks of their own: the calling thread runs queued tasks while it
+// waits for its ones.
+// returns when every task is done. if tasks throw, the first exception caught
+// is rethrown once all of them are done.
+// Param 1: the number of tasks
+// Param 2: the function
+template <class F>
+void parallel_tasks(int tasks, F&& function) {
+  assert(tasks >= 1);
+
+  if (tasks == 1) {
+    function(0);
+    return;
+  }
+
+  // tasks still running, and the first exception thrown by one of them
+  std::mutex mutex;
+  std::condition_variable done;
+  int remaining{tasks};
+  std::exception_ptr error;
+
+  auto run_task = [&](int task) {
+    std::exception_ptr task_error;
+    try {
+      function(task);
+    } catch (...) {
+      task_error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock{mutex};
+    if (task_error && !error) {
+      error = task_error;
+    }
+    if (--remaining == 0) {
+      done.notify_all();
+    }
+  };
+
+  Thread_pool& pool = thread_pool();
+  for (int task = 1; task != tasks; ++task) {
+    pool.submit([&run_task, task] { run_task(task); });
+  }
+  // the calling thread takes the first task, then the queued tasks, until
+  // its tasks are all taken
+  run_task(0);
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (remaining == 0) {
+        break;
+      }
+    }
+    if (!pool.run_one()) {
+      break;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock{mutex};
+  done.wait(lock, [&remaining] { return remaining == 0; });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// template function, so it can take any callable.
+// splits [0, size) into chunk_count(size) contiguous chunks and calls
+// function(chunk, begin, end) for each of them with parallel_tasks.
+// chunks are numbered in order, so the results can be merged deterministically.
+// Param 1: the size of the loop
+// Param 2: the function
+template <class F>
+void parallel_chunks(int size, F&& function) {
+  assert(size >= 0);
+  int chunks = chunk_count(size);
+
+  // first index of the provided chunk (long long prevents overflow)
+  auto chunk_begin = [size, chunks](int chunk) {
+    return static_cast<int>(static_cast<long long>(size) * chunk / chunks);
+  };
+
+  parallel_tasks(chunks, [&](int chunk) {
+    function(chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+  });
+}
+
+// calls function(i) for each i in [0, size), splitting the loop between
+// threads with parallel_chunks. iterations must be independent of each other.
+// Param 1: the size of the loop
+// Param 2: the function
+template <class F>
+void parallel_for(int size, F&& function) {
+  parallel_chunks(size, [&function](int, int begin, int end) {
+    for (int i = begin; i != end; ++i) {
+      function(i);
+    }
+  });
+}
+}  // namespace boids
+#endif
@@ -1,22 +1,63 @@
 #include "quadtree.hpp"
 
-#include <algorithm>  //for std::find, std::for_each
+#include <algorithm>  //for std::find, std::clamp, std::stable_sort
+#include <array>
 #include <cassert>
+#include <cstddef>  //for std::size_t
+#include <initializer_list>
 #include <iostream>
 #include <memory>  //for make_unique
 #include <vector>
 
 #include "boid.hpp"
+#include "neighbours.hpp"
 #include "point.hpp"
 
 namespace boids {
+void append_cell(sf::VertexArray& lines, double left, double top,
+                 double width, double height) {
+  sf::Vector2f top_left(left, top);
+  sf::Vector2f top_right(left + width, top);
+  sf::Vector2f bottom_right(left + width, top + height);
+  sf::Vector2f bottom_left(left, top + height);
+  for (const auto& corner : {top_left, top_right, top_right, bottom_right,
+                             bottom_right, bottom_left, bottom_left,
+                             top_left}) {
+    lines.append(sf::Vertex(corner, constants::tree_color));
+  }
+}
+
 bool Rectangle::contains(const Point& p) const {
-  return (p.x() > x - w && p.x() < x + w && p.y() < y + h && p.y() > y - h);
+  return (p.x() >= x - w && p.x() < x + w && p.y() < y + h && p.y() >= y - h);
+}
+
+Point Rectangle::clamp(const Point& p) const {
+  return Point{std::clamp(p.x(), x - w, x + w),
+               std::clamp(p.y(), y - h, y + h)};
+}
+
+Rectangle Rectangle::expand(const Point& p) const {
+  double left = std::min(x - w, p.x());
+  double right = std::max(x + w, p.x());
+  double lower = std::min(y - h, p.y());
+  double upper = std::max(y + h, p.y());
+  return Rectangle{(left + right) / 2., (lower + upper) / 2.,
+                   (right - left) / 2., (upper - lower) / 2.};
 }
 
-Quad_tree::Quad_tree(int capacity, const Rectangle& boundary)
-    : m_capacity{capacity}, m_boundary{boundary} {
+double Rectangle::squared_distance(const Point& p) const {
+  double dx = std::max({x - w - p.x(), 0., p.x() - x - w});
+  double dy = std::max({y - h - p.y(), 0., p.y() - y - h});
+  return dx * dx + dy * dy;
+}
+
+Quad_tree::Quad_tree(int capacity, const Rectangle& boundary, int max_depth)
+    : m_capacity{capacity},
+      m_max_depth{max_depth},
+      m_boundary{boundary},
+      m_query_boundary{boundary} {
   assert(capacity > 0);
+  assert(max_depth >= 0);
 }
 
 void Quad_tree::subdivide() {
@@ -28,65 +69,79 @@ void Quad_tree::subdivide() {
   Rectangle ne = Rectangle{m_boundary.x + m_boundary.w / 2.,
                            m_boundary.y + m_boundary.h / 2., m_boundary.w / 2.,
                            m_boundary.h / 2.};
-  northeast = std::make_unique<Quad_tree>(m_capacity, ne);
+  northeast = std::make_unique<Quad_tree>(m_capacity, ne, m_max_depth - 1);
 
   Rectangle nw = Rectangle{m_boundary.x - m_boundary.w / 2.,
                            m_boundary.y + m_boundary.h / 2., m_boundary.w / 2.,
                            m_boundary.h / 2.};
-  northwest = std::make_unique<Quad_tree>(m_capacity, nw);
+  northwest = std::make_unique<Quad_tree>(m_capacity, nw, m_max_depth - 1);
 
   Rectangle se = Rectangle{m_boundary.x + m_boundary.w / 2.,
                            m_boundary.y - m_boundary.h / 2., m_boundary.w / 2.,
                            m_boundary.h / 2.};
-  southeast = std::make_unique<Quad_tree>(m_capacity, se);
+  southeast = std::make_unique<Quad_tree>(m_capacity, se, m_max_depth - 1);
 
   Rectangle sw = Rectangle{m_boundary.x - m_boundary.w / 2.,
                            m_boundary.y - m_boundary.h / 2., m_boundary.w / 2.,
                            m_boundary.h / 2.};
-  southwest = std::make_unique<Quad_tree>(m_capacity, sw);
+  southwest = std::make_unique<Quad_tree>(m_capacity, sw, m_max_depth - 1);
   m_divided = true;
 }
 
+Quad_tree& Quad_tree::child(const Point& p) {
+  assert(m_divided);
+  // points on the center lines go to the east/north cells, consistently with
+  // Rectangle::contains
+  if (p.x() >= m_boundary.x) {
+    return p.y() >= m_boundary.y ? *northeast : *southeast;
+  }
+  return p.y() >= m_boundary.y ? *northwest : *southwest;
+}
+
 void Quad_tree::insert(const Boid& boid) {
   // checks if passing already inserted boid
   assert(std::none_of(
       m_boids_ptr.begin(), m_boids_ptr.end(),
       [&boid](const Boid* boid_ptr) { return &boid == boid_ptr; }));
 
-  if (m_boundary.contains(boid.pos())) {
-    if ((static_cast<int>(m_boids_ptr.size()) < m_capacity && !m_divided)) {
-      m_boids_ptr.push_back(&boid);
-    }
+  // boids outside of the mother cell are placed on the border of the cell,
+  // and the query boundary of every cell they pass through is enlarged to
+  // reach them
+  Point position = boid.pos();
+  if (!m_boundary.contains(position)) {
+    m_query_boundary = m_query_boundary.expand(position);
+    position = m_boundary.clamp(position);
+  }
 
-    else {
-      if (!m_divided) {
-        subdivide();
-
-        // transfering boids in m_boids_ptr to children cells
-        for (auto& inserted_boids : m_boids_ptr) {
-          assert(inserted_boids);
-          northeast->insert(*inserted_boids);
-          northwest->insert(*inserted_boids);
-          southeast->insert(*inserted_boids);
-          southwest->insert(*inserted_boids);
-        }
+  // cells at maximum depth never subdivide, they keep all their boids
+  if ((static_cast<int>(m_boids_ptr.size()) < m_capacity ||
+       m_max_depth == 0) &&
+      !m_divided) {
+    m_boids_ptr.push_back(&boid);
+    return;
+  }
 
-        m_boids_ptr.clear();
-      }
+  if (!m_divided) {
+    subdivide();
 
-      northeast->insert(boid);
-      northwest->insert(boid);
-      southeast->insert(boid);
-      southwest->insert(boid);
+    // transfering boids in m_boids_ptr to children cells
+    for (auto& inserted_boid : m_boids_ptr) {
+      assert(inserted_boid);
+      child(m_boundary.clamp(inserted_boid->pos())).insert(*inserted_boid);
     }
+
+    m_boids_ptr.clear();
   }
+
+  child(position).insert(boid);
 }
 
 bool Quad_tree::square_collide(double range, const Boid& boid) const {
-  if (boid.pos().x() + range < m_boundary.x - m_boundary.w ||
-      boid.pos().x() - range > m_boundary.x + m_boundary.w ||
-      boid.pos().y() + range < m_boundary.y - m_boundary.h ||
-      boid.pos().y() - range > m_boundary.y + m_boundary.h) {
+  const Rectangle& bound = m_query_boundary;
+  if (boid.pos().x() + range < bound.x - bound.w ||
+      boid.pos().x() - range > bound.x + bound.w ||
+      boid.pos().y() + range < bound.y - bound.h ||
+      boid.pos().y() - range > bound.y + bound.h) {
     return false;
   }
 
@@ -94,8 +149,10 @@ bool Quad_tree::square_collide(double range, const Boid& boid) const {
 }
 
 void Quad_tree::query(double range, const Boid& boid,
-                      std::vector<const Boid*>& in_range) const {
-  assert(range >= 0.);  
+                      std::vector<const Boid*>& in_range,
+                      int max_neighbours) const {
+  assert(range >= 0.);
+  assert(max_neighbours >= 0);
   if (!square_collide(range, boid)) {
     return;
   }
@@ -105,39 +162,143 @@ void Quad_tree::query(double range, const Boid& boid,
 
     if ((other_boid_ptr->pos() - boid.pos()).distance() < range) {
       if (&boid != other_boid_ptr) {
+        // early out, once enough neighbours have been found
+        if (max_neighbours != 0 &&
+            static_cast<int>(in_range.size()) >= max_neighbours) {
+          return;
+        }
         in_range.push_back(other_boid_ptr);
       }
     }
   }
 
   if (m_divided) {
-    northeast->query(range, boid, in_range);
-    northwest->query(range, boid, in_range);
-    southeast->query(range, boid, in_range);
-    southwest->query(range, boid, in_range);
+    if (max_neighbours == 0) {
+      northeast->query(range, boid, in_range);
+      northwest->query(range, boid, in_range);
+      southeast->query(range, boid, in_range);
+      southwest->query(range, boid, in_range);
+    } else {
+      // with a limit, the closest cells are visited first, so the kept
+      // neighbours surround the boid instead of lying on one side
+      for (auto child_cell : children_by_distance(boid.pos())) {
+        child_cell->query(range, boid, in_range, max_neighbours);
+      }
+    }
   }
 }
 
-void Quad_tree::display(sf::RenderWindow& window) {
-  sf::RectangleShape rect;
-  rect.setOutlineColor(constants::tree_color);
-  rect.setOutlineThickness(constants::displayed_cell_thickness);
-  rect.setFillColor(sf::Color(0, 255, 0, 0));
-  sf::Vector2f pos;
+std::array<const Quad_tree*, 4> Quad_tree::children_by_distance(
+    const Point& p) const {
+  assert(m_divided);
+  std::array<std::pair<double, const Quad_tree*>, 4> children{
+      {{northeast->m_query_boundary.squared_distance(p), northeast.get()},
+       {northwest->m_query_boundary.squared_distance(p), northwest.get()},
+       {southeast->m_query_boundary.squared_distance(p), southeast.get()},
+       {southwest->m_query_boundary.squared_distance(p), southwest.get()}}};
+  // ties are broken by the fixed order above, so the order is deterministic
+  std::stable_sort(children.begin(), children.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.first < b.first;
+                   });
+  return {children[0].second, children[1].second, children[2].second,
+          children[3].second};
+}
 
-  pos = sf::Vector2f(m_boundary.x - m_boundary.w, m_boundary.y - m_boundary.h);
-  rect.setPosition(pos);
-  rect.setSize(sf::Vector2f(m_boundary.w * 2, m_boundary.h * 2));
+void Quad_tree::search_nearest(const Boid& boid,
+                               Nearest_boids& nearest) const {
+  if (m_query_boundary.squared_distance(boid.pos()) >= nearest.worst()) {
+    return;
+  }
 
-  window.draw(rect);
+  for (auto other_boid_ptr : m_boids_ptr) {
+    assert(other_boid_ptr);
+    if (other_boid_ptr != &boid) {
+      Point distance = other_boid_ptr->pos() - boid.pos();
+      nearest.offer(distance.x() * distance.x() + distance.y() * distance.y(),
+                    other_boid_ptr);
+    }
+  }
+
+  if (m_divided) {
+    // closest children first, so the farther ones are more likely skipped
+    for (auto child_cell : children_by_distance(boid.pos())) {
+      child_cell->search_nearest(boid, nearest);
+    }
+  }
+}
+
+void Quad_tree::k_nearest(int k, const Boid& boid,
+                          std::vector<const Boid*>& nearest_boids) const {
+  assert(k >= 0);
+  Nearest_boids nearest{k};
+  search_nearest(boid, nearest);
+  nearest.write(nearest_boids);
+}
+
+std::size_t Quad_tree::memory_usage() const {
+  std::size_t bytes = sizeof(Quad_tree) +
+                      m_boids_ptr.capacity() * sizeof(const Boid*);
+  if (m_divided) {
+    bytes += northeast->memory_usage() + northwest->memory_usage() +
+             southeast->memory_usage() + southwest->memory_usage();
+  }
+  return bytes;
+}
+
+void Quad_tree::cells(sf::VertexArray& lines) const {
+  append_cell(lines, m_boundary.x - m_boundary.w, m_boundary.y - m_boundary.h,
+              m_boundary.w * 2, m_boundary.h * 2);
 
-  //displaying also child cells
+  // adding also child cells
   if (m_divided) {
-    northwest->display(window);
-    northeast->display(window);
-    southeast->display(window);
-    southwest->display(window);
+    northwest->cells(lines);
+    northeast->cells(lines);
+    southeast->cells(lines);
+    southwest->cells(lines);
+  }
+}
+
+Capacity_tuner::Capacity_tuner(int capacity, int min_capacity,
+                               int max_capacity, int step, int sample_frames)
+    : m_capacity{capacity},
+      m_min_capacity{min_capacity},
+      m_max_capacity{max_capacity},
+      m_step{step},
+      m_sample_frames{sample_frames} {
+  assert(min_capacity > 0);
+  assert(min_capacity <= capacity && capacity <= max_capacity);
+  assert(step > 0 && sample_frames > 0);
+}
+
+int Capacity_tuner::capacity() const { return m_capacity; }
+
+void Capacity_tuner::record(double cost) {
+  assert(cost >= 0.);
+  m_cost_sum += cost;
+  ++m_samples;
+
+  if (m_samples < m_sample_frames) {
     return;
   }
+
+  double average_cost = m_cost_sum / m_samples;
+  m_cost_sum = 0.;
+  m_samples = 0;
+
+  // if the last change made things worse, go back the other way
+  if (m_previous_cost >= 0. && average_cost > m_previous_cost) {
+    m_direction = -m_direction;
+  }
+  m_previous_cost = average_cost;
+
+  int new_capacity = m_capacity + m_direction * m_step;
+
+  // bounces off the limits
+  if (new_capacity < m_min_capacity || new_capacity > m_max_capacity) {
+    m_direction = -m_direction;
+    new_capacity = m_capacity + m_direction * m_step;
+  }
+  m_capacity = std::clamp(new_capacity, m_min_capacity, m_max_capacity);
 }
 }  // namespace boids
\ No newline at end of file
@@ -2,15 +2,28 @@
 #ifndef QUADTREE_HPP
 #define QUADTREE_HPP
 
+#include <SFML/Graphics.hpp>
+#include <array>
 #include <cassert>
+#include <cstddef>  //for std::size_t
 #include <iostream>
 #include <vector>
 #include <memory> //for unique_ptr
 
 #include "boid.hpp"
+#include "constants.hpp"
 #include "point.hpp"
 
 namespace boids {
+// appends the four edges of a cell to a vertex array of lines, in
+// constants::tree_color. the cells of a whole tree are drawn at once
+// Param 1: the vertex array
+// Param 2: x of the top left corner
+// Param 3: y of the top left corner
+// Param 4: the width
+// Param 5: the height
+void append_cell(sf::VertexArray&, double, double, double, double);
+
 struct Rectangle {
   // position of center of rectangle
   double x{};
@@ -20,24 +33,70 @@ struct Rectangle {
   double w{};
   double h{};
 
-  // checks if point is contained in rectangle
+  // checks if point is contained in rectangle. the left and lower sides are
+  // included, the right and upper sides are not, so that adjacent cells never
+  // both contain the same point
   // needed to check if boid is contained in quad tree cell
   // Param 1: the point
   bool contains(const Point&) const;
+
+  // returns the point of the rectangle (sides included) closest to the
+  // provided point
+  // Param 1: the point
+  Point clamp(const Point&) const;
+
+  // returns the smallest rectangle containing both this rectangle and the
+  // provided point
+  // Param 1: the point
+  Rectangle expand(const Point&) const;
+
+  // returns the square of the distance between the point and the closest
+  // point of the rectangle, 0 if the point is inside
+  // Param 1: the point
+  double squared_distance(const Point&) const;
 };
 
+class Nearest_boids;
+
 class Quad_tree {
   // maximum number of boids in a cell
   // if exceeded, insert() calls subdivide()
   const int m_capacity{};
 
+  // number of further subdivisions allowed below this cell. when it reaches
+  // 0 the cell becomes an overflow leaf, that accepts boids beyond
+  // m_capacity. prevents unbounded recursion when many boids share the same
+  // position
+  const int m_max_depth{};
+
   // rectangle object representing the mother (biggest) cell
   Rectangle m_boundary{};
   bool m_divided = false;
 
+  // m_boundary, enlarged to contain the boids inserted from outside of it.
+  // used by square_collide, so those boids are still found by query()
+  Rectangle m_query_boundary{};
+
   // initializes children cells, sets m_divided = true
   void subdivide();
 
+  // returns the child cell containing the provided point. the cell must be
+  // divided
+  // Param 1: the point
+  Quad_tree& child(const Point&);
+
+  // offers the boids of the cell and of its children to the provided
+  // Nearest_boids, visiting the closest children first and skipping the
+  // cells farther than the farthest boid kept so far
+  // Param 1: the boid
+  // Param 2: the nearest boids found so far
+  void search_nearest(const Boid&, Nearest_boids&) const;
+
+  // returns the children cells, from the closest to the provided point. the
+  // cell must be divided
+  // Param 1: the point
+  std::array<const Quad_tree*, 4> children_by_distance(const Point&) const;
+
   // boids in cell, gets populated by insert()
   // gets emptied if m_divided = true
   std::vector<const Boid*> m_boids_ptr;
@@ -51,13 +110,16 @@ class Quad_tree {
  public:
   // Param 1: m_capacity
   // Param 2: m_boundary
-  Quad_tree(int, const Rectangle&);
+  // Param 3: m_max_depth
+  Quad_tree(int, const Rectangle&, int = constants::max_tree_depth);
 
   // calls delete_tree to handle heap allocated children cells
   //~Quad_tree();
 
-  // if boid is inside the cell it pushes back the boid pointer to boids_ptr
-  // if m_divided = true then it gets passed to children cells
+  // pushes back the boid pointer to boids_ptr. if m_divided = true then it
+  // gets passed to the child cell containing it. boids outside of the cell are
+  // inserted as if they were at the closest point of the cell, so every boid
+  // is stored exactly once
   // Param 1: the boid to insert
   void insert(const Boid&);
 
@@ -69,13 +131,67 @@ class Quad_tree {
   // populates the provided vector of boid pointers with pointers to boids
   // contained within the quad tree that are within the specified range from the
   // given boid.
+  // if a maximum number of neighbours is given, the query stops as soon as
+  // the vector holds that many boids. cells are then visited from the closest
+  // to the boid, so the same boids are always selected for the same tree.
   // Param 1: the range
   // Param 2: the boid Param 3: the vector of boid pointers
-  void query(double, const Boid&, std::vector<const Boid*>&) const;
+  // Param 4: maximum number of neighbours, 0 for no limit
+  void query(double, const Boid&, std::vector<const Boid*>&, int = 0) const;
+
+  // populates the provided vector of boid pointers with pointers to the k
+  // boids contained within the quad tree closest to the given boid (itself
+  // excluded), from the closest. fewer if the tree has fewer boids.
+  // Param 1: k
+  // Param 2: the boid
+  // Param 3: the vector of boid pointers
+  void k_nearest(int, const Boid&, std::vector<const Boid*>&) const;
+
+  // returns the number of bytes allocated by the tree, children cells included
+  std::size_t memory_usage() const;
+
+  // appends the edges of the cells of the tree (children cells included) to
+  // the vertex array, see append_cell
+  // Param 1: the vertex array of lines
+  void cells(sf::VertexArray&) const;
+};
+
+// tunes the cell capacity of the quad tree at run time. the cost (time spent
+// building and querying the tree, per boid) is averaged over a number of
+// frames, then the capacity is moved by a step in the direction that lowered
+// the cost last time (hill climbing). the capacity is kept between a minimum
+// and a maximum.
+class Capacity_tuner {
+  int m_capacity{};
+  const int m_min_capacity{};
+  const int m_max_capacity{};
+  const int m_step{};
+  const int m_sample_frames{};
+
+  // +1 or -1, direction of the next capacity change
+  int m_direction{1};
+
+  // sum of the costs recorded with the current capacity
+  double m_cost_sum{};
+  int m_samples{};
+
+  // average cost of the previous capacity, negative if not yet measured
+  double m_previous_cost{-1.};
+
+ public:
+  // Param 1: initial capacity
+  // Param 2: minimum capacity
+  // Param 3: maximum capacity
+  // Param 4: m_step
+  // Param 5: m_sample_frames, the frames averaged before each change
+  Capacity_tuner(int, int, int, int, int);
+
+  // returns the capacity to use for the next tree
+  int capacity() const;
 
-  // displays the quad tree (children cell included) to the provided window
-  // Param 1: the window
-  void display(sf::RenderWindow&);
+  // records the cost of a frame built with capacity()
+  // Param 1: the cost
+  void record(double);
 };
 }  // namespace boids
 #endif
\ No newline at end of file
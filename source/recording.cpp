@@ -0,0 +1,374 @@
+#include "recording.hpp"
+
+#include <algorithm>  //for std::clamp, std::fill, std::upper_bound
+#include <cassert>
+#include <cmath>    //for std::lround
+#include <cstddef>  //for std::size_t
+#include <cstdint>
+#include <cstring>  //for std::memcmp
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>  //for std::move
+#include <vector>
+
+#include "boid.hpp"
+#include "constants.hpp"
+#include "handles.hpp"
+#include "parallel.hpp"
+#include "world.hpp"
+
+namespace boids {
+namespace {
+// throws std::runtime_error with the provided message if the condition is
+// false
+void require(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error{"recording: " + message};
+  }
+}
+
+// returns the value as a multiple of the quantum, clamped to the range of
+// std::int32_t
+std::int32_t quantize_value(double value, double quantum) {
+  constexpr double max = std::numeric_limits<std::int32_t>::max();
+  return static_cast<std::int32_t>(
+      std::lround(std::clamp(value / quantum, -max, max)));
+}
+
+// appends the value as a variable length integer: seven bits per byte, from
+// the least significant ones, the highest bit set on every byte but the last
+void put_varint(std::string& buffer, std::uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+// reads a variable length integer written by put_varint, from the data of
+// the provided size
+std::uint64_t get_varint(const char* data, std::size_t size,
+                         std::size_t& position) {
+  std::uint64_t value{0};
+  for (int shift = 0; shift < 64; shift += 7) {
+    require(position < size, "truncated frame");
+    auto byte = static_cast<unsigned char>(data[position++]);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error{"recording: invalid integer"};
+}
+
+// zigzag encoding maps small negative and positive numbers to small unsigned
+// ones: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+// appends the differences between the values and the previous ones
+void encode(std::string& buffer, const std::vector<std::int32_t>& values,
+            const std::vector<std::int32_t>& previous) {
+  assert(values.size() == previous.size());
+  for (std::size_t i = 0; i != values.size(); ++i) {
+    put_varint(buffer, zigzag(static_cast<std::int64_t>(values[i]) -
+                              previous[i]));
+  }
+}
+
+// adds the differences read from the data of the provided size to the
+// values
+void decode(const char* data, std::size_t size, std::size_t& position,
+            std::vector<std::int32_t>& values) {
+  for (auto& value : values) {
+    value = static_cast<std::int32_t>(
+        value + unzigzag(get_varint(data, size, position)));
+  }
+}
+}  // namespace
+
+Recorder::Recorder(const std::string& path, const World& world, int period)
+    : m_file{path, std::ios::binary | std::ios::trunc} {
+  assert(period > 0);
+  require(static_cast<bool>(m_file), "cannot create " + path);
+
+  m_header.period = static_cast<std::uint32_t>(period);
+  m_header.chunk_frames =
+      static_cast<std::uint32_t>(constants::recording_chunk_frames);
+  m_header.keyframe_period =
+      static_cast<std::uint32_t>(constants::recording_keyframe_period);
+  m_header.min_x = world.min_x;
+  m_header.min_y = world.min_y;
+  m_header.width = world.width;
+  m_header.height = world.height;
+  m_header.position_quantum = constants::position_quantum;
+  m_header.velocity_quantum = constants::velocity_quantum;
+  m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  require(static_cast<bool>(m_file), "cannot write " + path);
+
+  m_writer = std::thread{[this] { write_frames(); }};
+}
+
+Recorder::~Recorder() { close(); }
+
+template <class T>
+void Recorder::quantize(const std::vector<T>& bird_vec,
+                        const Handles& handles,
+                        std::vector<std::int32_t>& values) {
+  assert(handles.size() == static_cast<int>(bird_vec.size()));
+  m_order.clear();
+  for (int handle = 0; handle != handles.capacity(); ++handle) {
+    int index = handles.index(handle);
+    if (index != -1) {
+      m_order.push_back(index);
+    }
+  }
+
+  values.resize(4 * m_order.size());
+  parallel_for(static_cast<int>(m_order.size()), [&](int i) {
+    const T& bird = bird_vec[m_order[i]];
+    values[4 * i] = quantize_value(bird.pos().x() - m_header.min_x,
+                                   m_header.position_quantum);
+    values[4 * i + 1] = quantize_value(bird.pos().y() - m_header.min_y,
+                                       m_header.position_quantum);
+    values[4 * i + 2] =
+        quantize_value(bird.vel().x(), m_header.velocity_quantum);
+    values[4 * i + 3] =
+        quantize_value(bird.vel().y(), m_header.velocity_quantum);
+  });
+}
+
+void Recorder::record(std::uint64_t step, const std::vector<Boid>& boid_vec,
+                      const Handles& boid_handles,
+                      const std::vector<Predator>& predator_vec,
+                      const Handles& predator_handles) {
+  if (step % m_header.period != 0) {
+    return;
+  }
+
+  Recorded_frame frame;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_closing) {
+      return;
+    }
+    if (static_cast<int>(m_queue.size()) >= constants::recorder_queue_size) {
+      ++m_dropped;
+      return;
+    }
+    if (!m_spare_frames.empty()) {
+      frame = std::move(m_spare_frames.back());
+      m_spare_frames.pop_back();
+    }
+  }
+
+  // only the writer thread removes frames from the queue, so there is still
+  // room for this one
+  frame.step = step;
+  quantize(boid_vec, boid_handles, frame.boids);
+  quantize(predator_vec, predator_handles, frame.predators);
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_queue.push_back(std::move(frame));
+  }
+  m_condition.notify_one();
+}
+
+void Recorder::write_frames() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+  while (true) {
+    m_condition.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+    if (m_queue.empty()) {
+      return;
+    }
+    Recorded_frame frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    bool failed = m_failed;
+
+    lock.unlock();
+    bool written = !failed && write_frame(frame);
+    lock.lock();
+
+    m_failed = !written;
+    m_spare_frames.push_back(std::move(frame));
+  }
+}
+
+bool Recorder::write_frame(const Recorded_frame& frame) {
+  auto boid_count = static_cast<std::uint32_t>(frame.boids.size() / 4);
+  auto predator_count = static_cast<std::uint32_t>(frame.predators.size() / 4);
+
+  // the differences are taken within a chunk of birds of the same number
+  if (m_chunk_offset < 0 || m_chunk.frame_count == m_header.chunk_frames ||
+      m_chunk.boid_count != boid_count ||
+      m_chunk.predator_count != predator_count) {
+    if (!end_chunk()) {
+      return false;
+    }
+    m_chunk = Chunk_header{};
+    m_chunk.first_frame = m_frames;
+    m_chunk.boid_count = boid_count;
+    m_chunk.predator_count = predator_count;
+
+    // the header is written again by end_chunk, once the chunk is complete.
+    // until then it holds no frames, so readers skip the chunk
+    m_chunk_offset = m_file.tellp();
+    m_file.write(reinterpret_cast<const char*>(&m_chunk), sizeof(m_chunk));
+  }
+
+  // keyframes are differences from zero
+  if (m_chunk.frame_count % m_header.keyframe_period == 0) {
+    m_chunk.keyframes[m_chunk.frame_count / m_header.keyframe_period] =
+        m_chunk.size;
+    m_previous.boids.assign(frame.boids.size(), 0);
+    m_previous.predators.assign(frame.predators.size(), 0);
+  }
+
+  m_buffer.clear();
+  put_varint(m_buffer, frame.step);
+  encode(m_buffer, frame.boids, m_previous.boids);
+  encode(m_buffer, frame.predators, m_previous.predators);
+  m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+
+  m_chunk.size += m_buffer.size();
+  ++m_chunk.frame_count;
+  ++m_frames;
+  m_previous.boids = frame.boids;
+  m_previous.predators = frame.predators;
+  return static_cast<bool>(m_file);
+}
+
+bool Recorder::end_chunk() {
+  if (m_chunk_offset < 0) {
+    return true;
+  }
+  auto end = m_file.tellp();
+  m_file.seekp(m_chunk_offset);
+  m_file.write(reinterpret_cast<const char*>(&m_chunk), sizeof(m_chunk));
+  m_file.seekp(end);
+  m_chunk_offset = -1;
+  return static_cast<bool>(m_file);
+}
+
+bool Recorder::close() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_closing = true;
+  }
+  m_condition.notify_one();
+
+  if (m_writer.joinable()) {
+    m_writer.join();
+    if (!m_failed && !end_chunk()) {
+      m_failed = true;
+    }
+    m_file.close();
+  }
+  return !m_failed;
+}
+
+int Recorder::dropped() {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_dropped;
+}
+
+Recording::Recording(const std::string& path) : m_file{path} {
+  const Recording_header expected;
+  require(m_file.size() >= sizeof(m_header), path + " is not a recording");
+  std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+  require(std::memcmp(m_header.magic, expected.magic,
+                      sizeof(m_header.magic)) == 0,
+          path + " is not a recording");
+  require(m_header.version == recording_version, "unsupported version");
+  require(m_header.byte_order == expected.byte_order, "wrong byte order");
+  require(m_header.period > 0 && m_header.position_quantum > 0. &&
+              m_header.velocity_quantum > 0.,
+          "invalid header");
+  // the offsets of the keyframes of a full chunk fit in its header
+  require(m_header.keyframe_period > 0 &&
+              m_header.chunk_frames <=
+                  std::uint64_t{m_header.keyframe_period} * chunk_keyframes,
+          "invalid header");
+
+  // the chunks follow each other. the last one may be incomplete, if the
+  // recorder did not close the file
+  std::size_t offset = sizeof(m_header);
+  while (m_file.size() - offset >= sizeof(Chunk_header)) {
+    Chunk chunk;
+    std::memcpy(&chunk.header, m_file.data() + offset, sizeof(chunk.header));
+    offset += sizeof(chunk.header);
+    if (chunk.header.frame_count == 0 ||
+        chunk.header.first_frame != m_frame_count ||
+        chunk.header.size > m_file.size() - offset) {
+      break;
+    }
+    chunk.offset = offset;
+    m_chunks.push_back(chunk);
+    m_frame_count += chunk.header.frame_count;
+    offset += chunk.header.size;
+  }
+}
+
+const Recording_header& Recording::header() const { return m_header; }
+
+std::uint64_t Recording::frame_count() const { return m_frame_count; }
+
+void Recording::decode_next() {
+  const Chunk& chunk = m_chunks[m_chunk];
+  const char* data = m_file.data() + chunk.offset;
+  std::size_t size = chunk.header.size;
+  if ((m_frame - chunk.header.first_frame) % m_header.keyframe_period == 0) {
+    std::fill(m_current.boids.begin(), m_current.boids.end(), 0);
+    std::fill(m_current.predators.begin(), m_current.predators.end(), 0);
+  }
+  m_current.step = get_varint(data, size, m_position);
+  decode(data, size, m_position, m_current.boids);
+  decode(data, size, m_position, m_current.predators);
+  ++m_frame;
+}
+
+const Recorded_frame& Recording::frame(std::uint64_t index) {
+  assert(index < m_frame_count);
+
+  // last chunk starting at or before the frame
+  auto chunk = std::upper_bound(m_chunks.begin(), m_chunks.end(), index,
+                                [](std::uint64_t frame, const Chunk& chunk) {
+                                  return frame < chunk.header.first_frame;
+                                }) -
+               1;
+  int chunk_index = static_cast<int>(chunk - m_chunks.begin());
+
+  // last keyframe at or before the frame
+  std::uint64_t keyframe =
+      (index - chunk->header.first_frame) / m_header.keyframe_period;
+  std::uint64_t keyframe_index =
+      chunk->header.first_frame + keyframe * m_header.keyframe_period;
+
+  // frames are decoded from the keyframe, unless the frame follows the last
+  // decoded one with no keyframe in between
+  if (chunk_index != m_chunk || index + 1 < m_frame ||
+      m_frame < keyframe_index) {
+    m_chunk = chunk_index;
+    m_position = chunk->header.keyframes[keyframe];
+    require(m_position < chunk->header.size, "invalid keyframe offset");
+    m_frame = keyframe_index;
+    m_current.boids.assign(4 * std::size_t{chunk->header.boid_count}, 0);
+    m_current.predators.assign(4 * std::size_t{chunk->header.predator_count},
+                               0);
+  }
+
+  while (m_frame <= index) {
+    decode_next();
+  }
+  return m_current;
+}
+}  // namespace boids
@@ -0,0 +1,216 @@
+// recording of the trajectories of the birds, for offline analysis and
+// replay. a recording file is made of:
+// - a Recording_header;
+// - chunks of frames, each made of a Chunk_header and of the encoded frames.
+// positions and velocities are quantized to multiples of the quanta of the
+// header. each frame stores, for every bird, the difference between its
+// quantized values and the ones of the previous frame of the chunk, as zigzag
+// variable length integers: birds move little between frames, so most
+// differences take one or two bytes. every keyframe_period frames of a chunk,
+// from its first one, the keyframe stores the differences from zero, i.e.
+// the values themselves, and the chunk header holds its offset, so that
+// frames can be decoded without the ones before the keyframe.
+// birds are stored in the order of their handles, so every bird keeps its
+// place between frames even if the vector gets sorted. a chunk ends after
+// constants::recording_chunk_frames frames, or when the number of birds
+// changes.
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>  //for std::size_t
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boid.hpp"
+#include "constants.hpp"
+#include "handles.hpp"
+#include "mapped_file.hpp"
+#include "world.hpp"
+
+namespace boids {
+
+// current version of the format, increased at every incompatible change
+inline constexpr std::uint32_t recording_version{2};
+
+// number of keyframes in a full chunk
+inline constexpr int chunk_keyframes{constants::recording_chunk_frames /
+                                     constants::recording_keyframe_period};
+static_assert(constants::recording_chunk_frames %
+                  constants::recording_keyframe_period ==
+              0);
+
+struct Recording_header {
+  char magic[8]{'B', 'O', 'I', 'D', 'R', 'E', 'C', 'D'};
+  std::uint32_t version{recording_version};
+  // 0x01020304 as written, to detect files from machines with another order
+  std::uint32_t byte_order{0x01020304};
+  // steps between recorded frames
+  std::uint32_t period{};
+  std::uint32_t chunk_frames{};
+  std::uint32_t keyframe_period{};
+  std::uint32_t padding{};
+  // the world of the simulation, quantized positions are relative to its
+  // top left corner
+  double min_x{};
+  double min_y{};
+  double width{};
+  double height{};
+  double position_quantum{};
+  double velocity_quantum{};
+};
+
+struct Chunk_header {
+  std::uint64_t first_frame{};
+  // size of the encoded frames, following the header
+  std::uint64_t size{};
+  std::uint32_t frame_count{};
+  std::uint32_t boid_count{};
+  std::uint32_t predator_count{};
+  std::uint32_t padding{};
+  // offsets of the keyframes from the start of the encoded frames
+  std::array<std::uint64_t, chunk_keyframes> keyframes{};
+};
+
+// a frame with quantized values: x, y, velocity x and velocity y of each
+// bird, one after the other
+struct Recorded_frame {
+  std::uint64_t step{};
+  std::vector<std::int32_t> boids;
+  std::vector<std::int32_t> predators;
+};
+
+// writes a recording on a background thread. frames are quantized on the
+// calling thread, then queued: encoding and writing never stall the
+// simulation, and frames are dropped if the queue is full.
+class Recorder {
+  std::ofstream m_file;
+  Recording_header m_header{};
+
+  // frames waiting to be written, and frames already written, whose memory
+  // is reused for the next ones
+  std::deque<Recorded_frame> m_queue;
+  std::vector<Recorded_frame> m_spare_frames;
+  bool m_closing{false};
+  bool m_failed{false};
+  int m_dropped{0};
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+
+  // state of the writer thread: the chunk being written, the last written
+  // frame and the encoding buffer
+  Chunk_header m_chunk{};
+  std::streamoff m_chunk_offset{-1};
+  Recorded_frame m_previous;
+  std::string m_buffer;
+  std::uint64_t m_frames{0};
+
+  // indices of the birds in the order of their handles
+  std::vector<int> m_order;
+
+  std::thread m_writer;
+
+  // writes the queued frames until the recorder is closed
+  void write_frames();
+
+  // encodes and writes a frame, starting a new chunk if needed. returns
+  // false if writing failed
+  // Param 1: the frame
+  bool write_frame(const Recorded_frame&);
+
+  // writes the header of the current chunk, if any, and ends it. returns
+  // false if writing failed
+  bool end_chunk();
+
+  // quantizes the birds, in the order of their handles
+  // Param 1: vector of birds
+  // Param 2: their handles
+  // Param 3: the quantized values
+  template <class T>
+  void quantize(const std::vector<T>&, const Handles&,
+                std::vector<std::int32_t>&);
+
+ public:
+  // creates the file and starts the writer thread. throws
+  // std::runtime_error if the file cannot be created
+  // Param 1: path of the file
+  // Param 2: the world of the simulation
+  // Param 3: steps between recorded frames, positive
+  Recorder(const std::string&, const World&, int);
+
+  // writes the queued frames and closes the file
+  ~Recorder();
+
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  // queues a frame with the birds, if the step is a multiple of the period
+  // of the recorder and the queue is not full
+  // Param 1: the step
+  // Param 2: vector of boids
+  // Param 3: handles of the boids
+  // Param 4: vector of predators
+  // Param 5: handles of the predators
+  void record(std::uint64_t, const std::vector<Boid>&, const Handles&,
+              const std::vector<Predator>&, const Handles&);
+
+  // writes the queued frames and closes the file. returns false if writing
+  // failed at some point
+  bool close();
+
+  // returns the number of frames dropped because the queue was full
+  int dropped();
+};
+
+// reads a recording written by Recorder. the file is mapped in memory, so
+// opening a long recording costs nothing and frames can be read in any
+// order. reading them forward is the fastest.
+class Recording {
+  // a chunk and the offset of its frames in the file
+  struct Chunk {
+    Chunk_header header{};
+    std::size_t offset{};
+  };
+
+  Mapped_file m_file;
+  Recording_header m_header{};
+  std::vector<Chunk> m_chunks;
+  std::uint64_t m_frame_count{0};
+
+  // the current chunk, the position of its next frame and the last decoded
+  // frame
+  int m_chunk{-1};
+  std::size_t m_position{0};
+  std::uint64_t m_frame{0};
+  Recorded_frame m_current;
+
+  // decodes the next frame of the current chunk into m_current. keyframes
+  // are decoded from zero
+  void decode_next();
+
+ public:
+  // maps the file and reads the list of its chunks. throws
+  // std::runtime_error if the file is not a recording of this version
+  // Param 1: path of the file
+  explicit Recording(const std::string&);
+
+  const Recording_header& header() const;
+
+  // returns the number of complete frames
+  std::uint64_t frame_count() const;
+
+  // decodes the frame with the provided index, in [0, frame_count()), from
+  // the last decoded frame if it is on the way, otherwise from the last
+  // keyframe before it. the frame stays valid until the next call. throws
+  // std::runtime_error if the file is corrupted
+  // Param 1: the index
+  const Recorded_frame& frame(std::uint64_t);
+};
+}  // namespace boids
+#endif
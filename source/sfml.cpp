@@ -1,11 +1,83 @@
 #include "sfml.hpp"
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>  //for std::max
+#include <cassert>
+#include <cstddef>  //for std::size_t
+#include <cstdint>
+#include <vector>
 
+#include "boid.hpp"
 #include "constants.hpp"
+#include "parallel.hpp"
+#include "point.hpp"
+#include "recording.hpp"
+#include "world.hpp"
 
 namespace boids {
-void display_circle(sf::RenderWindow& window, double radius, Boid& boid,
+namespace {
+// writes the triangles of the recorded birds, four values per bird
+void replay_flock(const std::vector<std::int32_t>& values,
+                  const Recording_header& header, sf::VertexArray& vertices,
+                  double size, sf::Color color) {
+  std::size_t count = values.size() / 4;
+  fit_vertices(vertices, count, color);
+
+  parallel_for(static_cast<int>(count), [&](int i) {
+    Bird bird{Point{header.min_x + values[4 * i] * header.position_quantum,
+                    header.min_y + values[4 * i + 1] * header.position_quantum},
+              Point{values[4 * i + 2] * header.velocity_quantum,
+                    values[4 * i + 3] * header.velocity_quantum}};
+    vertex_update(vertices, bird, i, size);
+  });
+}
+}  // namespace
+
+void fit_vertices(sf::VertexArray& vertices, std::size_t count,
+                  sf::Color color, bool recolor) {
+  if (recolor || vertices.getVertexCount() != 3 * count ||
+      vertices.getPrimitiveType() != sf::Triangles) {
+    vertices.setPrimitiveType(sf::Triangles);
+    vertices.resize(3 * count);
+    for (std::size_t i = 0; i != 3 * count; ++i) {
+      vertices[i].color = color;
+    }
+  }
+}
+
+void interpolate_vertices(sf::VertexArray& shown,
+                          const sf::VertexArray& vertices,
+                          const std::vector<sf::Vector2f>& motion,
+                          double fraction) {
+  assert(!motion.empty());
+  assert(vertices.getVertexCount() % motion.size() == 0);
+  assert(fraction >= 0. && fraction <= 1.);
+  shown.setPrimitiveType(vertices.getPrimitiveType());
+  shown.resize(vertices.getVertexCount());
+
+  const auto back = static_cast<float>(1. - fraction);
+  const int per_bird = static_cast<int>(vertices.getVertexCount() /
+                                        motion.size());
+  parallel_for(static_cast<int>(motion.size()), [&](int i) {
+    for (int j = per_bird * i; j != per_bird * (i + 1); ++j) {
+      shown[j] = vertices[j];
+      shown[j].position.x -= back * motion[i].x;
+      shown[j].position.y -= back * motion[i].y;
+    }
+  });
+}
+
+void replay_vertices(const Recorded_frame& frame,
+                     const Recording_header& header,
+                     sf::VertexArray& boid_vertex,
+                     sf::VertexArray& predator_vertex) {
+  replay_flock(frame.boids, header, boid_vertex, constants::boid_size,
+               constants::boid_color);
+  replay_flock(frame.predators, header, predator_vertex,
+               constants::predator_size, constants::predator_color);
+}
+
+void display_circle(sf::RenderWindow& window, double radius, const Boid& boid,
                     sf::Color color) {
   assert(radius >= 0.);
   sf::CircleShape circle(radius);
@@ -20,4 +92,107 @@ void display_circle(sf::RenderWindow& window, double radius, Boid& boid,
 
   window.draw(circle);
 }
-}  // namespace boids
\ No newline at end of file
+
+Bird_renderer::Bird_renderer(bool use_buffer)
+    : m_use_buffer{use_buffer && sf::VertexBuffer::isAvailable()} {}
+
+void Bird_renderer::draw(sf::RenderTarget& target,
+                         const sf::VertexArray& vertices) {
+  std::size_t count = vertices.getVertexCount();
+  if (count == 0) {
+    return;
+  }
+
+  if (m_use_buffer) {
+    // the buffer grows geometrically, so that adding birds does not create
+    // it again at every frame
+    if (count > m_capacity) {
+      m_capacity = std::max(count, 2 * m_capacity);
+      m_use_buffer = m_buffer.create(m_capacity);
+    }
+    m_use_buffer = m_use_buffer &&
+                   m_buffer.update(&vertices[0], count, 0);
+  }
+
+  if (m_use_buffer) {
+    m_buffer.setPrimitiveType(vertices.getPrimitiveType());
+    target.draw(m_buffer, 0, count);
+  } else {
+    target.draw(vertices);
+  }
+}
+
+bool Bird_renderer::uses_buffer() const { return m_use_buffer; }
+
+Camera::Camera(const World& world) : m_world{world} {
+  assert(world.width > 0. && world.height > 0.);
+  // the view is drawn in the part of the window right of the control panel
+  double panel_fraction = constants::controls_width / constants::window_width;
+  m_view.setViewport(
+      sf::FloatRect(panel_fraction, 0., 1. - panel_fraction, 1.));
+  reset();
+}
+
+void Camera::reset() {
+  double viewport_width = constants::window_width - constants::controls_width;
+  double viewport_height = constants::window_height;
+  double scale = std::max(m_world.width / viewport_width,
+                          m_world.height / viewport_height);
+  m_view.setSize(viewport_width * scale, viewport_height * scale);
+  m_view.setCenter(m_world.min_x + m_world.width / 2.,
+                   m_world.min_y + m_world.height / 2.);
+}
+
+void Camera::handle_event(const sf::Event& event,
+                          const sf::RenderWindow& window) {
+  if (event.type == sf::Event::MouseWheelScrolled &&
+      event.mouseWheelScroll.x > constants::controls_width) {
+    // the point under the mouse stays in place
+    sf::Vector2i mouse{event.mouseWheelScroll.x, event.mouseWheelScroll.y};
+    sf::Vector2f before = window.mapPixelToCoords(mouse, m_view);
+    m_view.zoom(event.mouseWheelScroll.delta > 0
+                    ? 1. / constants::camera_zoom_factor
+                    : constants::camera_zoom_factor);
+    sf::Vector2f after = window.mapPixelToCoords(mouse, m_view);
+    m_view.move(before.x - after.x, before.y - after.y);
+  }
+
+  if (event.type == sf::Event::KeyPressed) {
+    double step_x = constants::camera_pan_fraction * m_view.getSize().x;
+    double step_y = constants::camera_pan_fraction * m_view.getSize().y;
+    switch (event.key.code) {
+      case sf::Keyboard::Left:
+        m_view.move(-step_x, 0.);
+        break;
+      case sf::Keyboard::Right:
+        m_view.move(step_x, 0.);
+        break;
+      case sf::Keyboard::Up:
+        m_view.move(0., -step_y);
+        break;
+      case sf::Keyboard::Down:
+        m_view.move(0., step_y);
+        break;
+      case sf::Keyboard::Home:
+        reset();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+const sf::View& Camera::view() const { return m_view; }
+
+sf::FloatRect Camera::visible_area() const {
+  return sf::FloatRect(m_view.getCenter().x - m_view.getSize().x / 2.f,
+                       m_view.getCenter().y - m_view.getSize().y / 2.f,
+                       m_view.getSize().x, m_view.getSize().y);
+}
+
+double Camera::pixel_size(const sf::Vector2u& window_size) const {
+  // a minimized window may have no pixels
+  return m_view.getSize().x /
+         (m_view.getViewport().width * std::max(window_size.x, 1u));
+}
+}  // namespace boids
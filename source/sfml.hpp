@@ -3,55 +3,207 @@
 #ifndef SFML_HPP_118
 #define SFML_HPP_118
 #include <SFML/Graphics.hpp>
+#include <cassert>
+#include <cstddef>  //for std::size_t
 #include <string>
 #include <vector>
 
 #include "boid.hpp"
+#include "constants.hpp"
+#include "parallel.hpp"
 #include "point.hpp"
+#include "recording.hpp"
+#include "world.hpp"
 
 namespace boids {
 // template function, so it can handle both boids and predators
 // updates the position and orientation of the triangle representing the
-// provided boid
+// provided boid. the tip is twice the size ahead of the bird, along its
+// velocity, the other two vertices are the size away, at 120 degrees from
+// the tip. the rotation uses the precomputed constants::cos_120 and
+// constants::sin_120
 // Param 1: vertex array of boids/predators
 // Param 2: the boid/predator
 // Param 3: the position of the first vertex of the boid/predator in the vertex
 // array
 // Param 4: the size of the boid/predator
-
 template <class T>
 void vertex_update(sf::VertexArray& swarm_vertex, const T& bird, int index,
                    double size) {
-  Point forward_vertex{0., 0.};
+  const Point pos = bird.pos();
+  const Point vel = bird.vel();
+  const double speed = vel.distance();
 
-  // to prevent division by zero.
-  if ((bird.vel()).distance() != 0.)
-    forward_vertex = (size / bird.vel().distance()) * (bird.vel());
+  // vector of the provided size along the velocity. null if the bird is
+  // still, to prevent division by zero.
+  double forward_x{0.};
+  double forward_y{0.};
+  if (speed != 0.) {
+    forward_x = size / speed * vel.x();
+    forward_y = size / speed * vel.y();
+  }
 
+  // i have added the *2 so the front is longer, and we can distinguish it.
   swarm_vertex[3 * index].position =
-      // i have added the *2 so the front is longer,
-      // and we can distinguish it.
-      sf::Vector2f((bird.pos() + 2 * forward_vertex).x(),
-                   (bird.pos() + 2 * forward_vertex).y());
+      sf::Vector2f(pos.x() + 2. * forward_x, pos.y() + 2. * forward_y);
 
-  // rotate by 120
-  forward_vertex.rotate(2. / 3 * constants::pi);
+  // rotated by 120 and by 240 degrees
+  constexpr double cos{constants::cos_120};
+  constexpr double sin{constants::sin_120};
+  swarm_vertex[3 * index + 1].position =
+      sf::Vector2f(pos.x() + cos * forward_x - sin * forward_y,
+                   pos.y() + sin * forward_x + cos * forward_y);
+  swarm_vertex[3 * index + 2].position =
+      sf::Vector2f(pos.x() + cos * forward_x + sin * forward_y,
+                   pos.y() - sin * forward_x + cos * forward_y);
+}
 
-  swarm_vertex[(3 * index) + 1].position = sf::Vector2f(
-      (bird.pos() + forward_vertex).x(), (bird.pos() + forward_vertex).y());
+// template function, so it can handle both boids and predators
+// updates the triangles of all the birds, splitting them between threads.
+// the vertex array must hold three vertices per bird
+// Param 1: vertex array of boids/predators
+// Param 2: vector of boids/predators
+// Param 3: the size of the boids/predators
+template <class T>
+void update_vertices(sf::VertexArray& swarm_vertex,
+                     const std::vector<T>& bird_vec, double size) {
+  assert(swarm_vertex.getVertexCount() == 3 * bird_vec.size());
+  parallel_for(static_cast<int>(bird_vec.size()), [&](int i) {
+    vertex_update(swarm_vertex, bird_vec[i], i, size);
+  });
+}
 
-  forward_vertex.rotate(2. / 3 * constants::pi);
+// template function, so it can handle both boids and predators
+// like update_vertices, for the birds with the provided indices only: the
+// triangle of bird shown[j] is the j-th of the vertex array, which must hold
+// three vertices per index
+// Param 1: vertex array of boids/predators
+// Param 2: vector of boids/predators
+// Param 3: the indices of the birds
+// Param 4: the size of the boids/predators
+template <class T>
+void update_vertices(sf::VertexArray& swarm_vertex,
+                     const std::vector<T>& bird_vec,
+                     const std::vector<int>& shown, double size) {
+  assert(swarm_vertex.getVertexCount() == 3 * shown.size());
+  parallel_for(static_cast<int>(shown.size()), [&](int j) {
+    vertex_update(swarm_vertex, bird_vec[shown[j]], j, size);
+  });
+}
 
-  swarm_vertex[(3 * index) + 2].position = sf::Vector2f(
-      (bird.pos() + forward_vertex).x(), (bird.pos() + forward_vertex).y());
+// template function, so it can handle both boids and predators
+// writes the displacement of the birds with the provided indices since their
+// previous positions, the shortest one across the edges of a toroidal world.
+// the displacement of bird shown[j] is the j-th
+// Param 1: the displacements
+// Param 2: vector of boids/predators
+// Param 3: the indices of the birds, see visible_birds
+// Param 4: their previous positions
+// Param 5: the world
+template <class T>
+void update_motion(std::vector<sf::Vector2f>& motion,
+                   const std::vector<T>& bird_vec,
+                   const std::vector<int>& shown,
+                   const std::vector<Point>& previous, const World& world) {
+  assert(previous.size() == bird_vec.size());
+  motion.resize(shown.size());
+  parallel_for(static_cast<int>(shown.size()), [&](int j) {
+    int i = shown[j];
+    Point displacement = world.displacement(bird_vec[i].pos(), previous[i]);
+    motion[j] = sf::Vector2f(displacement.x(), displacement.y());
+  });
 }
 
+// writes the vertices of the birds moved back along their displacement, so
+// that they are drawn the provided fraction of the way from their previous
+// positions to the current ones. each bird has the same number of vertices,
+// e.g. three for triangles
+// Param 1: the vertex array to draw
+// Param 2: vertex array of boids/predators, at their current positions
+// Param 3: displacements of the boids/predators, see update_motion
+// Param 4: the fraction, in [0, 1]
+void interpolate_vertices(sf::VertexArray&, const sf::VertexArray&,
+                          const std::vector<sf::Vector2f>&, double);
+
+// resizes the vertex array to three vertices per bird. when the number of
+// birds or the type of primitives changes, or if asked to, every vertex gets
+// the provided color again
+// Param 1: vertex array of boids/predators
+// Param 2: number of birds
+// Param 3: the color of the birds
+// Param 4: if true the vertices are colored again in any case
+void fit_vertices(sf::VertexArray&, std::size_t, sf::Color, bool = false);
+
+// writes the triangles of the birds of a recorded frame, as vertex_update
+// does for the simulated ones. the vertex arrays are resized, and colored
+// again, when the numbers of birds change.
+// Param 1: the frame
+// Param 2: the header of the recording
+// Param 3: vertex array of boids
+// Param 4: vertex array of predators
+void replay_vertices(const Recorded_frame&, const Recording_header&,
+                     sf::VertexArray&, sf::VertexArray&);
+
 // displays a circle of provided radius, centered on the position of a provided
 // boid.
 // Param 1: the window object on which to draw the circle
 // Param 2: the radious of the circle
 // Param 3: the boid
 // Param 4: the color of the circle
-void display_circle(sf::RenderWindow&, double, Boid&, sf::Color color);
+void display_circle(sf::RenderWindow&, double, const Boid&, sf::Color color);
+
+// draws the vertex arrays of the birds. when enabled and supported by the
+// driver, the vertices are streamed into a vertex buffer, which the graphics
+// card draws from its own memory. otherwise, or if the buffer cannot be
+// created or updated, e.g. by some software rasterizers, the vertex arrays
+// are drawn directly, as before.
+class Bird_renderer {
+  sf::VertexBuffer m_buffer{sf::Triangles, sf::VertexBuffer::Stream};
+  // number of vertices the buffer was created for
+  std::size_t m_capacity{0};
+  bool m_use_buffer{};
+
+ public:
+  // Param 1: true to use a vertex buffer, if available
+  explicit Bird_renderer(bool);
+
+  // draws the vertices
+  // Param 1: the target, e.g. the window
+  // Param 2: the vertex array
+  void draw(sf::RenderTarget&, const sf::VertexArray&);
+
+  // returns true if the vertex buffer is used
+  bool uses_buffer() const;
+};
+
+// view of the world shown in the window, right of the control panel. the
+// arrow keys move it, the mouse wheel zooms it around the mouse and the home
+// key brings back the whole world.
+class Camera {
+  World m_world{};
+  sf::View m_view{};
+
+  // makes the whole world visible, keeping the proportions of the window
+  void reset();
+
+ public:
+  // Param 1: m_world
+  explicit Camera(const World&);
+
+  // moves or zooms the view, according to the event
+  // Param 1: the event
+  // Param 2: the window
+  void handle_event(const sf::Event&, const sf::RenderWindow&);
+
+  // returns m_view
+  const sf::View& view() const;
+
+  // returns the rectangle of the world in view
+  sf::FloatRect visible_area() const;
+
+  // returns the width of a pixel of the window, in the units of the world
+  // Param 1: the size of the window, in pixels
+  double pixel_size(const sf::Vector2u&) const;
+};
 }  // namespace boids
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+// bounded queue from one producer thread to one consumer thread, without
+// locks. each side only writes its own index, and reads the other one to
+// know how far it can go: a push never waits for a pop, and a full queue
+// is reported to the producer instead of blocking it.
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>  //for std::size_t
+
+namespace boids {
+
+// template class, for any value that can be copied into a slot
+template <class T, std::size_t capacity>
+class Spsc_queue {
+  static_assert(capacity > 0);
+
+  std::array<T, capacity> m_slots{};
+
+  // number of values pushed and popped since the start. they only grow, the
+  // slot of a value is its number modulo the capacity. they live on separate
+  // cache lines, so the two threads do not keep taking the line from each
+  // other
+  alignas(64) std::atomic<std::size_t> m_pushed{0};
+  alignas(64) std::atomic<std::size_t> m_popped{0};
+
+ public:
+  // queues a copy of the value. returns false, without queuing it, if the
+  // queue is full. called by the producer only
+  // Param 1: the value
+  bool push(const T& value) {
+    std::size_t pushed = m_pushed.load(std::memory_order_relaxed);
+    if (pushed - m_popped.load(std::memory_order_acquire) == capacity) {
+      return false;
+    }
+    m_slots[pushed % capacity] = value;
+    m_pushed.store(pushed + 1, std::memory_order_release);
+    return true;
+  }
+
+  // takes the oldest value. returns false, leaving the argument untouched, if
+  // the queue is empty. called by the consumer only
+  // Param 1: where the value is copied
+  bool pop(T& value) {
+    std::size_t popped = m_popped.load(std::memory_order_relaxed);
+    if (popped == m_pushed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = m_slots[popped % capacity];
+    m_popped.store(popped + 1, std::memory_order_release);
+    return true;
+  }
+};
+}  // namespace boids
+#endif
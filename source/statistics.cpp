@@ -25,29 +25,28 @@ double calculate_standard_deviation(const std::vector<double>& data,
 }
 
 double calculate_mean_distance(const std::vector<Boid>& boid_vector) {
-  std::vector<double> distances;
+  // the distances are summed as they are computed, rather than stored: there
+  // is one per pair of boids
+  double sum{0.};
   // nested for loop, makes program lag
   std::for_each(boid_vector.begin(), boid_vector.end(), [&](const Boid& boid1) {
-    std::transform(boid_vector.begin(), boid_vector.end(),
-                   std::back_inserter(distances), [&](const Boid& boid2) {
-                     return (boid1.pos() - boid2.pos()).distance();
-                   });
+    for (const Boid& boid2 : boid_vector) {
+      sum += (boid1.pos() - boid2.pos()).distance();
+    }
   });
 
   double mean_distance =
-      std::accumulate(distances.begin(), distances.end(), 0.0) /
-      distances.size();
+      sum / static_cast<double>(boid_vector.size() * boid_vector.size());
   return mean_distance;
 }
 
 double calculate_mean_speed(const std::vector<Boid>& boid_vector) {
-  std::vector<double> speeds;
-  std::transform(boid_vector.begin(), boid_vector.end(),
-                 std::back_inserter(speeds),
-                 [](const Boid& boid) { return boid.vel().distance(); });
-
-  double mean_speed =
-      std::accumulate(speeds.begin(), speeds.end(), 0.0) / speeds.size();
+  double mean_speed = std::accumulate(boid_vector.begin(), boid_vector.end(),
+                                      0.0,
+                                      [](double sum, const Boid& boid) {
+                                        return sum + boid.vel().distance();
+                                      }) /
+                      boid_vector.size();
   return mean_speed;
 }
 }  // namespace boids
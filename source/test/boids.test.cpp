@@ -1,14 +1,40 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdio>  //for std::remove
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "./../boid.hpp"
+#include "./../checkpoint.hpp"
+#include "./../config.hpp"
+#include "./../frame_export.hpp"
+#include "./../handles.hpp"
 #include "doctest.h"
 #include "./../point.hpp"
+#include "./../kd_tree.hpp"
+#include "./../linear_quadtree.hpp"
+#include "./../lod.hpp"
+#include "./../neighbours.hpp"
+#include "./../parallel.hpp"
 #include "./../quadtree.hpp"
+#include "./../recording.hpp"
 #include "./../sfml.hpp"
+#include "./../spsc_queue.hpp"
 #include "./../statistics.hpp"
+#include "./../triple_buffer.hpp"
+#include "./../world.hpp"
 
 TEST_CASE("Testing the Point class") {
   SUBCASE("checking if x() and y() return m_x, m_y") {
@@ -573,8 +599,15 @@ TEST_CASE("testing Rectangle::contains") {
   CHECK(!rect.contains(p3));
   CHECK(!rect.contains(-1. * p3));
 
-  // contains does not include boundaries
+  // contains does not include right and upper boundaries
   CHECK(!rect.contains(p4));
+  CHECK(!rect.contains(boids::Point{10., 0.}));
+  CHECK(!rect.contains(boids::Point{0., 10.}));
+
+  // but includes left and lower ones
+  CHECK(rect.contains(-1. * p4));
+  CHECK(rect.contains(boids::Point{-10., 0.}));
+  CHECK(rect.contains(boids::Point{0., -10.}));
 }
 
 TEST_CASE("testing Quad_tree::square_collide and Quad_tree::insert") {
@@ -659,9 +692,7 @@ TEST_CASE("testing Quad_tree::query") {
 }
 
 TEST_CASE("testing Quad_tree::subdivide") {
-  SUBCASE(
-      "if boid is perfectly in between cells, then it is not capture by child "
-      "cells") {
+  SUBCASE("if boid is perfectly in between cells, it is captured by one cell") {
     boids::Rectangle square{0., 0., 1., 1.};
     boids::Quad_tree tree{1, square};
 
@@ -678,11 +709,1565 @@ TEST_CASE("testing Quad_tree::subdivide") {
 
     tree.query(1., boid3, in_range);
 
-    // both boid1 and boid2 are in the query range of boid3, but only boid1 has
-    // been passed to the in_range vector, because, being in_between the divided
-    // cells, boid2 has been dropped from the quad tree m_boids_ptr with the
-    // subdivision of the cell
-    CHECK(in_range[0] == &boid1);
+    // both boid1 and boid2 are in the query range of boid3, and boid2 is
+    // found exactly once even though it lies on the border of all the cells
+    CHECK(in_range.size() == 2);
+    CHECK(std::count(in_range.begin(), in_range.end(), &boid1) == 1);
+    CHECK(std::count(in_range.begin(), in_range.end(), &boid2) == 1);
+  }
+}
+
+TEST_CASE("testing Quad_tree with boids outside of the mother cell") {
+  boids::Rectangle square{0., 0., 1., 1.};
+  boids::Quad_tree tree{1, square};
+
+  std::vector<boids::Boid> flock{boids::Boid{boids::Point{0.5, 0.5}},
+                                 boids::Boid{boids::Point{-0.5, 0.5}},
+                                 boids::Boid{boids::Point{3., 0.2}},
+                                 boids::Boid{boids::Point{1., 1.}}};
+  for (const auto& boid : flock) {
+    tree.insert(boid);
+  }
+
+  SUBCASE("boid far outside is found by a boid close to it") {
+    boids::Boid other{boids::Point{3.5, 0.2}};
+    std::vector<const boids::Boid*> in_range;
+    tree.query(1., other, in_range);
+    CHECK(in_range.size() == 1);
+    CHECK(in_range[0] == &flock[2]);
+  }
+
+  SUBCASE("every boid is found exactly once") {
+    boids::Boid other{};
+    std::vector<const boids::Boid*> in_range;
+    tree.query(10., other, in_range);
+    CHECK(in_range.size() == flock.size());
+    for (const auto& boid : flock) {
+      CHECK(std::count(in_range.begin(), in_range.end(), &boid) == 1);
+    }
+  }
+}
+
+TEST_CASE("testing Quad_tree maximum depth") {
+  SUBCASE("boids in the same position do not subdivide the tree forever") {
+    boids::Rectangle square{0., 0., 1., 1.};
+    boids::Quad_tree tree{1, square, 3};
+
+    std::vector<boids::Boid> clump(50, boids::Boid{boids::Point{0.3, 0.3}});
+    for (const auto& boid : clump) {
+      tree.insert(boid);
+    }
+
+    // all boids are kept by the overflow leaf
+    std::vector<const boids::Boid*> in_range;
+    tree.query(0.1, clump[0], in_range);
+    CHECK(in_range.size() == clump.size() - 1);
+  }
+}
+
+TEST_CASE("testing Capacity_tuner") {
+  SUBCASE("capacity does not change before enough frames are recorded") {
+    boids::Capacity_tuner tuner{10, 2, 64, 3, 30};
+    for (int i = 0; i != 29; ++i) {
+      tuner.record(1.);
+    }
+    CHECK(tuner.capacity() == 10);
+    tuner.record(1.);
+    CHECK(tuner.capacity() == 13);
+  }
+
+  SUBCASE("capacity goes back if the cost increases") {
+    boids::Capacity_tuner tuner{10, 2, 64, 2, 30};
+    for (int i = 0; i != 30; ++i) {
+      tuner.record(1.);
+    }
+    for (int i = 0; i != 30; ++i) {
+      tuner.record(2.);
+    }
+    CHECK(tuner.capacity() == 10);
+  }
+
+  SUBCASE("capacity stays within the limits") {
+    boids::Capacity_tuner tuner{4, 2, 6, 2, 30};
+    for (int i = 0; i != 20 * 30; ++i) {
+      tuner.record(1.);
+      CHECK(tuner.capacity() >= 2);
+      CHECK(tuner.capacity() <= 6);
+    }
+  }
+}
+
+TEST_CASE("testing morton_code") {
+  boids::Rectangle square{0., 0., 1., 1.};
+
+  SUBCASE("corners of the rectangle have the lowest and highest codes") {
+    CHECK(boids::morton_code(boids::Point{-1., -1.}, square) == 0);
+    CHECK(boids::morton_code(boids::Point{1., 1.}, square) == 0xffffffff);
+  }
+
+  SUBCASE("the two highest bits select the quadrant") {
+    // bit 0 is east, bit 1 is north
+    CHECK((boids::morton_code(boids::Point{-0.5, -0.5}, square) >> 30) == 0);
+    CHECK((boids::morton_code(boids::Point{0.5, -0.5}, square) >> 30) == 1);
+    CHECK((boids::morton_code(boids::Point{-0.5, 0.5}, square) >> 30) == 2);
+    CHECK((boids::morton_code(boids::Point{0.5, 0.5}, square) >> 30) == 3);
+  }
+
+  SUBCASE("points outside of the rectangle are clamped") {
+    CHECK(boids::morton_code(boids::Point{-5., -3.}, square) == 0);
+    CHECK(boids::morton_code(boids::Point{0.5, 7.}, square) ==
+          boids::morton_code(boids::Point{0.5, 1.}, square));
+  }
+}
+
+// fills the vector with the boids in range of the provided boid, checking all
+// the boids one by one
+void brute_force_query(double range, const boids::Boid& boid,
+                       const std::vector<boids::Boid>& flock,
+                       std::vector<const boids::Boid*>& in_range) {
+  for (const auto& other : flock) {
+    if ((other.pos() - boid.pos()).distance() < range && &other != &boid) {
+      in_range.push_back(&other);
+    }
+  }
+}
+
+// random flock, with a clump of boids in the same position and some boids
+// outside of the provided rectangle
+std::vector<boids::Boid> test_flock(int size, const boids::Rectangle& rect) {
+  std::mt19937 mt{42};
+  std::uniform_real_distribution<double> x{rect.x - 1.2 * rect.w,
+                                           rect.x + 1.2 * rect.w};
+  std::uniform_real_distribution<double> y{rect.y - 1.2 * rect.h,
+                                           rect.y + 1.2 * rect.h};
+  std::vector<boids::Boid> flock;
+  for (int i = 0; i != size; ++i) {
+    if (i % 10 == 0) {
+      flock.push_back(boids::Boid{boids::Point{rect.x, rect.y}});
+    } else {
+      flock.push_back(boids::Boid{boids::Point{x(mt), y(mt)}});
+    }
+  }
+  return flock;
+}
+
+// checks that the spatial index finds the same boids as brute force
+template <class Index>
+void check_against_brute_force(const Index& index,
+                               const std::vector<boids::Boid>& flock,
+                               double range, int step) {
+  for (int i = 0; i < static_cast<int>(flock.size()); i += step) {
+    std::vector<const boids::Boid*> expected;
+    std::vector<const boids::Boid*> found;
+    brute_force_query(range, flock[i], flock, expected);
+    index.query(range, flock[i], found);
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    CHECK(found == expected);
+  }
+}
+
+TEST_CASE("testing spatial_sort") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(1000, rect);
+  auto first = flock[0].pos();
+  auto unsorted = flock;
+
+  auto order = boids::spatial_sort(flock, rect);
+
+  SUBCASE("the first boid is left in place") {
+    CHECK(flock[0].pos().x() == first.x());
+    CHECK(flock[0].pos().y() == first.y());
+  }
+
+  SUBCASE("the other boids are sorted by morton code") {
+    for (int i = 2; i != static_cast<int>(flock.size()); ++i) {
+      CHECK(boids::morton_code(flock[i - 1].pos(), rect) <=
+            boids::morton_code(flock[i].pos(), rect));
+    }
+  }
+
+  SUBCASE("no boid is lost") {
+    auto sum_positions = [](const std::vector<boids::Boid>& boids) {
+      boids::Point sum{};
+      for (const auto& boid : boids) {
+        sum = sum + boid.pos();
+      }
+      return sum;
+    };
+    CHECK(flock.size() == unsorted.size());
+    CHECK(sum_positions(flock).x() ==
+          doctest::Approx(sum_positions(unsorted).x()));
+    CHECK(sum_positions(flock).y() ==
+          doctest::Approx(sum_positions(unsorted).y()));
+  }
+
+  SUBCASE("the returned order gives the old index of each boid") {
+    REQUIRE(order.size() == flock.size());
+    CHECK(order[0] == 0);
+    for (int i = 0; i != static_cast<int>(flock.size()); ++i) {
+      CHECK(flock[i].pos().x() == unsorted[order[i]].pos().x());
+      CHECK(flock[i].pos().y() == unsorted[order[i]].pos().y());
+    }
+  }
+}
+
+TEST_CASE("testing Linear_quad_tree::query") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+
+  SUBCASE("empty tree finds nothing") {
+    boids::Linear_quad_tree tree{4, rect};
+    std::vector<boids::Boid> flock;
+    tree.build(flock);
+    boids::Boid boid{boids::Point{500., 350.}};
+    std::vector<const boids::Boid*> in_range;
+    tree.query(100., boid, in_range);
+    CHECK(in_range.empty());
+  }
+
+  SUBCASE("query excludes the boid itself") {
+    boids::Linear_quad_tree tree{4, rect};
+    std::vector<boids::Boid> flock{boids::Boid{boids::Point{500., 350.}}};
+    tree.build(flock);
+    std::vector<const boids::Boid*> in_range;
+    tree.query(100., flock[0], in_range);
+    CHECK(in_range.empty());
+  }
+
+  SUBCASE("small flock gives the same result as brute force") {
+    boids::Linear_quad_tree tree{4, rect};
+    auto flock = test_flock(500, rect);
+    tree.build(flock);
+    check_against_brute_force(tree, flock, 40., 1);
+  }
+
+  SUBCASE("large flock gives the same result as brute force") {
+    boids::Linear_quad_tree tree{8, rect};
+    auto flock = test_flock(20000, rect);
+    tree.build(flock);
+    check_against_brute_force(tree, flock, 15., 97);
+
+    // rebuilding with another capacity reuses the tree
+    tree.set_capacity(2);
+    tree.build(flock);
+    check_against_brute_force(tree, flock, 15., 97);
+  }
+}
+
+TEST_CASE("testing Thread_pool and parallel_chunks") {
+  SUBCASE("the pool runs every task, before its end at the latest") {
+    std::atomic<int> done{0};
+    {
+      boids::Thread_pool pool{2};
+      for (int i = 0; i != 100; ++i) {
+        pool.submit([&done] { ++done; });
+      }
+      // the calling thread may help with the tasks still queued
+      while (pool.run_one()) {
+      }
+    }
+    CHECK(done == 100);
+  }
+
+  SUBCASE("every index is visited once, in chunks numbered in order") {
+    constexpr int size{10 * constants::min_parallel_size + 7};
+    std::vector<int> visits(size, 0);
+    std::vector<int> chunk_of(size, -1);
+    boids::parallel_chunks(size, [&](int chunk, int begin, int end) {
+      for (int i = begin; i != end; ++i) {
+        ++visits[i];
+        chunk_of[i] = chunk;
+      }
+    });
+    CHECK(std::all_of(visits.begin(), visits.end(),
+                      [](int count) { return count == 1; }));
+    CHECK(std::is_sorted(chunk_of.begin(), chunk_of.end()));
+  }
+
+  SUBCASE("an exception thrown by a chunk reaches the caller") {
+    constexpr int size{10 * constants::min_parallel_size};
+    CHECK_THROWS_AS(boids::parallel_chunks(size,
+                                           [](int chunk, int, int) {
+                                             if (chunk == 0) {
+                                               throw std::runtime_error{"0"};
+                                             }
+                                           }),
+                    std::runtime_error);
+    // the pool is still usable afterwards
+    int sum{0};
+    boids::parallel_chunks(3, [&sum](int, int begin, int end) {
+      sum += end - begin;
+    });
+    CHECK(sum == 3);
+  }
+
+  SUBCASE("tasks start tasks of their own") {
+    std::atomic<int> leaves{0};
+    std::function<void(int)> split = [&](int depth) {
+      if (depth == 0) {
+        ++leaves;
+        return;
+      }
+      boids::parallel_tasks(2, [&](int) { split(depth - 1); });
+    };
+    split(5);
+    CHECK(leaves == 32);
+
+    CHECK_THROWS_AS(boids::parallel_tasks(2,
+                                          [&](int task) {
+                                            split(3);
+                                            if (task == 1) {
+                                              throw std::runtime_error{"1"};
+                                            }
+                                          }),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("testing Kd_tree::query") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+
+  SUBCASE("empty tree finds nothing") {
+    boids::Kd_tree tree{4};
+    std::vector<boids::Boid> flock;
+    tree.build(flock);
+    boids::Boid boid{boids::Point{500., 350.}};
+    std::vector<const boids::Boid*> in_range;
+    tree.query(100., boid, in_range);
+    CHECK(in_range.empty());
+  }
+
+  SUBCASE("query excludes the boid itself") {
+    boids::Kd_tree tree{1};
+    std::vector<boids::Boid> flock{boids::Boid{boids::Point{500., 350.}}};
+    tree.build(flock);
+    std::vector<const boids::Boid*> in_range;
+    tree.query(100., flock[0], in_range);
+    CHECK(in_range.empty());
+  }
+
+  SUBCASE("small flock gives the same result as brute force") {
+    // with every capacity the cells are laid out differently
+    auto flock = test_flock(500, rect);
+    for (int capacity = 1; capacity != 12; ++capacity) {
+      boids::Kd_tree tree{capacity};
+      tree.build(flock);
+      check_against_brute_force(tree, flock, 40., 7);
+    }
+  }
+
+  SUBCASE("large flock gives the same result as brute force") {
+    boids::Kd_tree tree{8};
+    auto flock = test_flock(20001, rect);
+    tree.build(flock);
+    check_against_brute_force(tree, flock, 15., 97);
+  }
+}
+
+// checks that k_nearest of the spatial index finds boids as close as the k
+// closest ones found by brute force. boids at the same distance may be
+// exchanged, so the distances are compared
+template <class Index>
+void check_nearest_against_brute_force(const Index& index,
+                                       const std::vector<boids::Boid>& flock,
+                                       int k, int step) {
+  for (int i = 0; i < static_cast<int>(flock.size()); i += step) {
+    std::vector<double> expected;
+    for (const auto& other : flock) {
+      if (&other != &flock[i]) {
+        expected.push_back((other.pos() - flock[i].pos()).distance());
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min<std::size_t>(k, expected.size()));
+
+    std::vector<const boids::Boid*> nearest;
+    index.k_nearest(k, flock[i], nearest);
+    std::vector<double> found;
+    for (auto boid_ptr : nearest) {
+      CHECK(boid_ptr != &flock[i]);
+      found.push_back((boid_ptr->pos() - flock[i].pos()).distance());
+    }
+
+    // returned from the closest
+    CHECK(std::is_sorted(found.begin(), found.end()));
+    REQUIRE(found.size() == expected.size());
+    for (int j = 0; j != static_cast<int>(found.size()); ++j) {
+      CHECK(found[j] == doctest::Approx(expected[j]));
+    }
+  }
+}
+
+TEST_CASE("testing k_nearest of the spatial indices") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(2000, rect);
+
+  SUBCASE("quad tree") {
+    boids::Quad_tree tree{4, rect};
+    for (const auto& boid : flock) {
+      tree.insert(boid);
+    }
+    check_nearest_against_brute_force(tree, flock, 7, 13);
+    check_nearest_against_brute_force(tree, flock, 0, 13);
+  }
+
+  SUBCASE("linear quad tree") {
+    boids::Linear_quad_tree tree{4, rect};
+    tree.build(flock);
+    check_nearest_against_brute_force(tree, flock, 7, 13);
+    check_nearest_against_brute_force(tree, flock, 0, 13);
+  }
+
+  SUBCASE("k-d tree") {
+    boids::Kd_tree tree{4};
+    tree.build(flock);
+    check_nearest_against_brute_force(tree, flock, 7, 13);
+    check_nearest_against_brute_force(tree, flock, 0, 13);
+  }
+
+  SUBCASE("k larger than the flock gives every other boid") {
+    std::vector<boids::Boid> small_flock(flock.begin(), flock.begin() + 5);
+    boids::Kd_tree tree{2};
+    tree.build(small_flock);
+    check_nearest_against_brute_force(tree, small_flock, 10, 1);
+
+    boids::Linear_quad_tree linear_tree{2, rect};
+    linear_tree.build(small_flock);
+    check_nearest_against_brute_force(linear_tree, small_flock, 10, 1);
+  }
+}
+
+// checks the query of the spatial index with a maximum number of neighbours:
+// it returns at most that many boids, all within range, always the same ones,
+// and all of them when the limit is not reached
+template <class Index>
+void check_limited_query(const Index& index,
+                         const std::vector<boids::Boid>& flock, double range,
+                         int max_neighbours, int step) {
+  for (int i = 0; i < static_cast<int>(flock.size()); i += step) {
+    std::vector<const boids::Boid*> all;
+    index.query(range, flock[i], all);
+
+    std::vector<const boids::Boid*> limited;
+    index.query(range, flock[i], limited, max_neighbours);
+    CHECK(static_cast<int>(limited.size()) ==
+          std::min(max_neighbours, static_cast<int>(all.size())));
+    for (auto boid_ptr : limited) {
+      CHECK((boid_ptr->pos() - flock[i].pos()).distance() < range);
+      CHECK(boid_ptr != &flock[i]);
+    }
+
+    std::vector<const boids::Boid*> repeated;
+    index.query(range, flock[i], repeated, max_neighbours);
+    CHECK(repeated == limited);
+  }
+}
+
+TEST_CASE("testing cells of the spatial indices") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(200, rect);
+  sf::VertexArray lines{sf::Lines};
+
+  // four edges per cell, the first from the top left corner to the top
+  // right one
+  auto check_first_cell = [&](double left, double top, double right,
+                              double bottom) {
+    REQUIRE(lines.getVertexCount() > 8);
+    CHECK(lines.getVertexCount() % 8 == 0);
+    CHECK(lines[0].position.x == doctest::Approx(left));
+    CHECK(lines[0].position.y == doctest::Approx(top));
+    CHECK(lines[1].position.x == doctest::Approx(right));
+    CHECK(lines[1].position.y == doctest::Approx(top));
+    CHECK(lines[4].position.x == doctest::Approx(right));
+    CHECK(lines[4].position.y == doctest::Approx(bottom));
+    CHECK(lines[7].position.x == doctest::Approx(left));
+    CHECK(lines[7].position.y == doctest::Approx(top));
+    CHECK(lines[0].color == constants::tree_color);
+  };
+
+  // the first cell of the quad trees is the mother cell
+  SUBCASE("quad tree") {
+    boids::Quad_tree tree{4, rect};
+    for (const auto& boid : flock) {
+      tree.insert(boid);
+    }
+    tree.cells(lines);
+    check_first_cell(rect.x - rect.w, rect.y - rect.h, rect.x + rect.w,
+                     rect.y + rect.h);
+  }
+
+  SUBCASE("linear quad tree") {
+    boids::Linear_quad_tree tree{4, rect};
+    tree.build(flock);
+    tree.cells(lines);
+    check_first_cell(rect.x - rect.w, rect.y - rect.h, rect.x + rect.w,
+                     rect.y + rect.h);
+  }
+
+  SUBCASE("k-d tree") {
+    // the first cell is the box of all the boids
+    boids::Kd_tree tree{4};
+    tree.build(flock);
+    tree.cells(lines);
+    auto [min_x, max_x] = std::minmax_element(
+        flock.begin(), flock.end(), [](const auto& a, const auto& b) {
+          return a.pos().x() < b.pos().x();
+        });
+    auto [min_y, max_y] = std::minmax_element(
+        flock.begin(), flock.end(), [](const auto& a, const auto& b) {
+          return a.pos().y() < b.pos().y();
+        });
+    check_first_cell(min_x->pos().x(), min_y->pos().y(), max_x->pos().x(),
+                     max_y->pos().y());
+  }
+}
+
+TEST_CASE("testing query with a maximum number of neighbours") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(2000, rect);
+
+  SUBCASE("quad tree") {
+    boids::Quad_tree tree{4, rect};
+    for (const auto& boid : flock) {
+      tree.insert(boid);
+    }
+    check_limited_query(tree, flock, 40., 5, 13);
+  }
+
+  SUBCASE("linear quad tree") {
+    boids::Linear_quad_tree tree{4, rect};
+    tree.build(flock);
+    check_limited_query(tree, flock, 40., 5, 13);
+  }
+
+  SUBCASE("k-d tree") {
+    boids::Kd_tree tree{4};
+    tree.build(flock);
+    check_limited_query(tree, flock, 40., 5, 13);
+  }
+}
+
+TEST_CASE("testing Nearest_boids") {
+  boids::Boid boid1{};
+  boids::Boid boid2{};
+  boids::Boid boid3{};
+  boids::Nearest_boids nearest{2};
+  CHECK(nearest.worst() == std::numeric_limits<double>::infinity());
+
+  nearest.offer(3., &boid1);
+  nearest.offer(1., &boid2);
+  CHECK(nearest.worst() == doctest::Approx(3.));
+
+  // closer than the farthest, it replaces it
+  nearest.offer(2., &boid3);
+  CHECK(nearest.worst() == doctest::Approx(2.));
+
+  std::vector<const boids::Boid*> result;
+  nearest.write(result);
+  CHECK(result == std::vector<const boids::Boid*>{&boid2, &boid3});
+}
+
+TEST_CASE("testing Verlet_list") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(2000, rect);
+  boids::Kd_tree tree{4};
+  tree.build(flock);
+
+  boids::Verlet_list verlet_list{10.};
+  CHECK(verlet_list.needs_rebuild(flock, 40.));
+  verlet_list.build(tree, flock, 40.);
+  CHECK(!verlet_list.needs_rebuild(flock, 40.));
+  CHECK(verlet_list.needs_rebuild(flock, 30.));
+
+  // every boid moves by less than half the skin, the lists still hold all
+  // the boids in range
+  std::mt19937 mt{7};
+  std::uniform_real_distribution<double> angle{0., 2. * constants::pi};
+  for (auto& boid : flock) {
+    double a = angle(mt);
+    boid = boids::Boid{boid.pos() + boids::Point{4.9 * std::cos(a),
+                                                  4.9 * std::sin(a)}};
+  }
+  CHECK(!verlet_list.needs_rebuild(flock, 40.));
+  for (int i = 0; i < static_cast<int>(flock.size()); i += 7) {
+    std::vector<const boids::Boid*> expected;
+    std::vector<const boids::Boid*> found;
+    brute_force_query(40., flock[i], flock, expected);
+    verlet_list.query(40., i, flock, found);
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    CHECK(found == expected);
+
+    std::vector<const boids::Boid*> limited;
+    verlet_list.query(40., i, flock, limited, 3);
+    CHECK(static_cast<int>(limited.size()) ==
+          std::min(3, static_cast<int>(expected.size())));
+  }
+
+  SUBCASE("a boid moving more than half the skin") {
+    flock[5] = boids::Boid{flock[5].pos() + boids::Point{6., 0.}};
+    CHECK(verlet_list.needs_rebuild(flock, 40.));
+  }
+
+  SUBCASE("a boid added") {
+    flock.push_back(boids::Boid{});
+    CHECK(verlet_list.needs_rebuild(flock, 40.));
+  }
+
+  SUBCASE("invalidated lists") {
+    verlet_list.invalidate();
+    CHECK(verlet_list.needs_rebuild(flock, 40.));
+  }
+}
+
+TEST_CASE("testing World") {
+  boids::World world{0., 0., 100., 50., true};
+
+  SUBCASE("wrap") {
+    boids::Point wrapped = world.wrap(boids::Point{105., -10.});
+    CHECK(wrapped.x() == doctest::Approx(5.));
+    CHECK(wrapped.y() == doctest::Approx(40.));
+    wrapped = world.wrap(boids::Point{100., 50.});
+    CHECK(wrapped.x() == doctest::Approx(0.));
+    CHECK(wrapped.y() == doctest::Approx(0.));
+
+    world.toroidal = false;
+    wrapped = world.wrap(boids::Point{105., -10.});
+    CHECK(wrapped.x() == doctest::Approx(105.));
+    CHECK(wrapped.y() == doctest::Approx(-10.));
+  }
+
+  SUBCASE("displacement") {
+    // the shortest way crosses the edges
+    boids::Point difference =
+        world.displacement(boids::Point{95., 2.}, boids::Point{5., 48.});
+    CHECK(difference.x() == doctest::Approx(-10.));
+    CHECK(difference.y() == doctest::Approx(4.));
+
+    world.toroidal = false;
+    difference =
+        world.displacement(boids::Point{95., 2.}, boids::Point{5., 48.});
+    CHECK(difference.x() == doctest::Approx(90.));
+    CHECK(difference.y() == doctest::Approx(-46.));
+  }
+
+  SUBCASE("images") {
+    std::array<boids::Point, 4> images;
+    CHECK(world.images(boids::Point{50., 25.}, 10., images) == 1);
+    CHECK(world.images(boids::Point{95., 25.}, 10., images) == 2);
+    CHECK(images[1].x() == doctest::Approx(-5.));
+    CHECK(world.images(boids::Point{5., 45.}, 10., images) == 4);
+    CHECK(images[3].x() == doctest::Approx(105.));
+    CHECK(images[3].y() == doctest::Approx(-5.));
+  }
+}
+
+TEST_CASE("testing periodic_query and periodic_k_nearest") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  boids::World world{100., 50., 800., 600., true};
+
+  // test flock wrapped inside the world, so that some boids are close to the
+  // edges
+  auto flock = test_flock(2000, rect);
+  for (auto& boid : flock) {
+    boid = boids::Boid{world.wrap(boid.pos())};
+  }
+  boids::Kd_tree tree{4};
+  tree.build(flock);
+
+  for (int i = 0; i < static_cast<int>(flock.size()); i += 7) {
+    std::vector<const boids::Boid*> expected;
+    for (const auto& other : flock) {
+      if (world.displacement(other.pos(), flock[i].pos()).distance() < 40. &&
+          &other != &flock[i]) {
+        expected.push_back(&other);
+      }
+    }
+    std::vector<const boids::Boid*> found;
+    boids::periodic_query(tree, world, 40., flock[i], found);
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    CHECK(found == expected);
+
+    // the nearest boids are found across the edges too
+    std::vector<const boids::Boid*> nearest;
+    boids::periodic_k_nearest(tree, world, 5, flock[i], nearest);
+    REQUIRE(nearest.size() == 5);
+    for (auto boid_ptr : expected) {
+      if (std::find(nearest.begin(), nearest.end(), boid_ptr) ==
+          nearest.end()) {
+        CHECK(world.displacement(boid_ptr->pos(), flock[i].pos()).distance() >=
+              world.displacement(nearest.back()->pos(), flock[i].pos())
+                  .distance());
+      }
+    }
+  }
+}
+
+TEST_CASE("testing periodic_k_nearest at the edge of a sparse world") {
+  // a thin world, and a boid at its bottom edge. the nearest boid is across
+  // that edge, but the boid itself is nearer to its own image than it is
+  boids::World world{0., 0., 100., 20., true};
+  std::vector<boids::Boid> flock{boids::Boid{boids::Point{50., 1.}},
+                                 boids::Boid{boids::Point{75., 19.}},
+                                 boids::Boid{boids::Point{78., 10.}}};
+  boids::Kd_tree tree{1};
+  tree.build(flock);
+  auto torus_distance = [&](const boids::Boid& other) {
+    return world.displacement(other.pos(), flock[0].pos()).distance();
+  };
+  REQUIRE(torus_distance(flock[1]) < torus_distance(flock[2]));
+  REQUIRE(torus_distance(flock[1]) > world.height);
+
+  std::vector<const boids::Boid*> nearest;
+  boids::periodic_k_nearest(tree, world, 1, flock[0], nearest);
+  REQUIRE(nearest.size() == 1);
+  CHECK(nearest[0] == &flock[1]);
+
+  nearest.clear();
+  boids::periodic_k_nearest(tree, world, 2, flock[0], nearest);
+  REQUIRE(nearest.size() == 2);
+  CHECK(nearest[0] == &flock[1]);
+  CHECK(nearest[1] == &flock[2]);
+}
+
+TEST_CASE("testing birds in a world larger than the window") {
+  boids::Config config{};
+  config.world = boids::World{0., 0., 10000., 10000., false};
+  boids::Point origin{0., 0.};
+  std::vector<const boids::Boid*> in_range;
+
+  SUBCASE("the margins are the ones of the world") {
+    // outside of the window, but far from the margins of the world
+    boids::Boid boid{boids::Point{5000., 5000.}, origin};
+    boid.update(1., in_range, 0., 0., 0., 0., config);
+    CHECK(boid.vel().x() == doctest::Approx(0.));
+    CHECK(boid.vel().y() == doctest::Approx(0.));
+
+    boids::Boid boid2{boids::Point{9990., 5000.}, origin};
+    boid2.update(1., in_range, 0., 0., 0., 0., config);
+    CHECK(boid2.vel().x() < 0.);
+  }
+
+  SUBCASE("in a toroidal world boids wrap around the edges") {
+    config.world.toroidal = true;
+    boids::Boid boid{boids::Point{9999., 5000.}, boids::Point{2., 0.}};
+    boid.update(1., in_range, 0., 0., 0., 0., config);
+    CHECK(boid.pos().x() == doctest::Approx(1.));
+    CHECK(boid.vel().x() == doctest::Approx(2.));
+
+    // cohesion pulls towards the boid across the edge
+    boids::Boid other_boid{boids::Point{9995., 5000.}, origin};
+    in_range.push_back(&other_boid);
+    boid.update(1., in_range, 0., 0., 1., 0., config);
+    CHECK(boid.vel().x() < 0.);
+  }
+}
+
+TEST_CASE("testing Config") {
+  boids::Config config{};
+
+  SUBCASE("the defaults are valid") { CHECK_NOTHROW(config.validate()); }
+
+  SUBCASE("settings are read from name=value lines") {
+    std::istringstream file{
+        "# a comment\n"
+        "\n"
+        "max_velocity = 5.5\n"
+        "max_boid_number=100000\n"
+        "spatial_index = kd_tree\n"
+        "toroidal_world = true\n"};
+    config.read(file);
+    CHECK(config.max_velocity == doctest::Approx(5.5));
+    CHECK(config.max_boid_number == 100000);
+    CHECK(config.spatial_index == constants::Spatial_index::kd_tree);
+    CHECK(config.world.toroidal);
+    CHECK_NOTHROW(config.validate());
+  }
+
+  SUBCASE("invalid settings are rejected") {
+    CHECK_THROWS_AS(config.set("max_speed", "3"), std::invalid_argument);
+    CHECK_THROWS_AS(config.set("max_velocity", "fast"), std::invalid_argument);
+    CHECK_THROWS_AS(config.set("cell_capacity", "3.5"), std::invalid_argument);
+    std::istringstream file{"max_velocity\n"};
+    CHECK_THROWS_AS(config.read(file), std::invalid_argument);
+
+    config.set("min_cell_capacity", "20");
+    CHECK_THROWS_AS(config.validate(), std::invalid_argument);
+    config = boids::Config{};
+    config.set("tuner_sample_frames", "0");
+    CHECK_THROWS_AS(config.validate(), std::invalid_argument);
+  }
+
+  SUBCASE("command line") {
+    std::string program{"boid"};
+    std::string setting{"max_velocity=4"};
+    std::string width{"5000"};
+    std::string height{"3000"};
+    char* argv[]{program.data(), setting.data(), width.data(), height.data()};
+    CHECK(boids::read_arguments(4, argv, config));
+    CHECK(config.max_velocity == doctest::Approx(4.));
+    CHECK(config.world.width == doctest::Approx(5000.));
+    CHECK(config.world.height == doctest::Approx(3000.));
+
+    boids::Config default_config{};
+    CHECK(!boids::read_arguments(1, argv, default_config));
+  }
+
+  SUBCASE("the configuration reaches the birds") {
+    config.max_velocity = 10.;
+    boids::Point window_center{
+        (constants::window_width - constants::controls_width) / 2.,
+        constants::window_height / 2.};
+    boids::Boid boid{window_center, boids::Point{4., 0.}};
+    boids::Boid other_boid{window_center + boids::Point{1., 0.}};
+    std::vector<const boids::Boid*> in_range{&other_boid};
+
+    // faster than constants::max_velocity, but slower than the configured
+    // one, so cohesion still applies
+    boid.update(1., in_range, 0., 0., 1., 0., config);
+    CHECK(boid.vel().x() == doctest::Approx(5.));
+  }
+
+  SUBCASE("written settings are read back") {
+    config.max_velocity = 0.1;
+    config.spatial_index = constants::Spatial_index::linear_quad_tree;
+    config.world.toroidal = true;
+    std::stringstream file;
+    config.write(file);
+
+    boids::Config read_config{};
+    read_config.read(file);
+    CHECK(read_config.max_velocity == config.max_velocity);
+    CHECK(read_config.spatial_index == config.spatial_index);
+    CHECK(read_config.world.toroidal);
+    CHECK(read_config.verlet_skin == config.verlet_skin);
+  }
+}
+
+TEST_CASE("testing Handles") {
+  boids::Handles handles;
+  handles.spawn(5);
+  CHECK(handles.size() == 5);
+  CHECK(handles.capacity() == 5);
+  for (int i = 0; i != 5; ++i) {
+    CHECK(handles.index(handles.handle(i)) == i);
+  }
+
+  SUBCASE("retired handles are reused") {
+    int last = handles.handle(4);
+    handles.retire(2);
+    CHECK(handles.size() == 3);
+    CHECK(handles.index(last) == -1);
+    handles.spawn(1);
+    CHECK(handles.capacity() == 5);
+    CHECK(handles.handle(3) == 3);
+    CHECK(handles.index(last) == -1);
+  }
+
+  SUBCASE("handles follow the birds when they are reordered") {
+    handles.reorder({0, 3, 4, 1, 2});
+    CHECK(handles.index(3) == 1);
+    CHECK(handles.index(1) == 3);
+    CHECK(handles.handle(2) == 4);
+
+    // the birds at the end of the vector are retired, whatever their handle
+    handles.retire(2);
+    CHECK(handles.index(1) == -1);
+    CHECK(handles.index(2) == -1);
+    CHECK(handles.index(4) == 2);
+  }
+
+  SUBCASE("birds retired at random are spread over the vector") {
+    handles.spawn(995);
+    std::vector<int> birds(1000);
+    for (int i = 0; i != 1000; ++i) {
+      birds[i] = i;
+    }
+    std::mt19937 mt{3};
+    boids::move_random_to_end(birds, handles, 500, mt);
+    for (int i = 0; i != 1000; ++i) {
+      CHECK(handles.index(handles.handle(i)) == i);
+      CHECK(handles.handle(i) == birds[i]);
+    }
+    // the birds kept come from both halves of the vector
+    int first_half = static_cast<int>(
+        std::count_if(birds.begin(), birds.begin() + 500,
+                      [](int bird) { return bird < 500; }));
+    CHECK(first_half > 200);
+    CHECK(first_half < 300);
+    // and every bird is still there once
+    std::sort(birds.begin(), birds.end());
+    for (int i = 0; i != 1000; ++i) {
+      CHECK(birds[i] == i);
+    }
+  }
+
+  SUBCASE("handles follow a spatial sort") {
+    boids::Rectangle rect{500., 350., 400., 300.};
+    auto flock = test_flock(5, rect);
+    auto unsorted = flock;
+    handles.reorder(boids::spatial_sort(flock, rect));
+    for (int handle = 0; handle != 5; ++handle) {
+      CHECK(flock[handles.index(handle)].pos().x() ==
+            unsorted[handle].pos().x());
+    }
+  }
+}
+
+TEST_CASE("testing checkpoints") {
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(10000, rect);
+  std::vector<boids::Predator> predators{
+      boids::Predator{boids::Point{1., 2.}, boids::Point{3., 4.}}};
+  boids::Config config{};
+  config.max_boid_number = 20000;
+  boids::Slider_values sliders{0.1, 0.2, 0.3, 40., 20., 50.};
+  std::mt19937 mt{42};
+
+  std::stringstream file{std::ios::in | std::ios::out | std::ios::binary};
+  boids::write_checkpoint(file, config, sliders, 123, mt, flock, predators);
+
+  SUBCASE("the simulation is read back") {
+    auto checkpoint = boids::read_checkpoint(file);
+    CHECK(checkpoint.config.max_boid_number == 20000);
+    CHECK(checkpoint.sliders.separation_coefficent == 0.3);
+    CHECK(checkpoint.sliders.prey_range == 50.);
+    CHECK(checkpoint.step == 123);
+    CHECK(checkpoint.mt() == mt());
+
+    REQUIRE(checkpoint.boids.size() == flock.size());
+    for (int i = 0; i != static_cast<int>(flock.size()); ++i) {
+      CHECK(checkpoint.boids[i].pos().x() == flock[i].pos().x());
+      CHECK(checkpoint.boids[i].vel().y() == flock[i].vel().y());
+    }
+    REQUIRE(checkpoint.predators.size() == 1);
+    CHECK(checkpoint.predators[0].pos().y() == 2.);
+    CHECK(checkpoint.predators[0].vel().x() == 3.);
+  }
+
+  SUBCASE("the arrays are aligned") {
+    boids::Checkpoint_header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    for (auto offset : {header.boids.x, header.boids.vel_y,
+                        header.predators.x, header.predators.vel_y}) {
+      CHECK(offset % constants::checkpoint_alignment == 0);
+    }
+    CHECK(header.boids.y - header.boids.x >= flock.size() * sizeof(double));
+  }
+
+  SUBCASE("invalid files are rejected") {
+    std::string content = file.str();
+    std::stringstream truncated{content.substr(0, content.size() / 2)};
+    CHECK_THROWS_AS(boids::read_checkpoint(truncated), std::runtime_error);
+
+    content[0] = 'X';
+    std::stringstream not_checkpoint{content};
+    CHECK_THROWS_AS(boids::read_checkpoint(not_checkpoint),
+                    std::runtime_error);
+
+    std::stringstream empty;
+    CHECK_THROWS_AS(boids::read_checkpoint(empty), std::runtime_error);
+  }
+}
+
+TEST_CASE("testing vertex_update and update_vertices") {
+  std::vector<boids::Boid> flock{
+      boids::Boid{boids::Point{100., 200.}, boids::Point{3., 4.}},
+      boids::Boid{boids::Point{-5., 7.}, boids::Point{-1., 0.5}},
+      boids::Boid{boids::Point{10., 10.}}};
+  sf::VertexArray vertices{sf::Triangles, 3 * flock.size()};
+  boids::update_vertices(vertices, flock, 5.);
+
+  for (int i = 0; i != static_cast<int>(flock.size()); ++i) {
+    // the triangle given by rotating the forward vector with Point::rotate
+    boids::Point forward{};
+    if (flock[i].vel().distance() != 0.) {
+      forward = (5. / flock[i].vel().distance()) * flock[i].vel();
+    }
+    std::vector<boids::Point> expected{flock[i].pos() + 2 * forward};
+    for (int j = 0; j != 2; ++j) {
+      forward.rotate(2. / 3 * constants::pi);
+      expected.push_back(flock[i].pos() + forward);
+    }
+
+    for (int j = 0; j != 3; ++j) {
+      CHECK(vertices[3 * i + j].position.x ==
+            doctest::Approx(expected[j].x()).epsilon(1e-6));
+      CHECK(vertices[3 * i + j].position.y ==
+            doctest::Approx(expected[j].y()).epsilon(1e-6));
+    }
+  }
+}
+
+TEST_CASE("testing Triple_buffer") {
+  boids::Triple_buffer<int> buffer;
+  CHECK(!buffer.update());
+
+  SUBCASE("the reader gets the last published value") {
+    buffer.back() = 1;
+    buffer.publish();
+    CHECK(buffer.update());
+    CHECK(buffer.front() == 1);
+    CHECK(!buffer.update());
+
+    buffer.back() = 2;
+    buffer.publish();
+    buffer.back() = 3;
+    buffer.publish();
+    CHECK(buffer.update());
+    CHECK(buffer.front() == 3);
+    CHECK(&buffer.back() != &buffer.front());
+  }
+
+  SUBCASE("values published by another thread arrive in order") {
+    constexpr int count{100000};
+    std::thread writer{[&buffer] {
+      for (int i = 1; i <= count; ++i) {
+        buffer.back() = i;
+        buffer.publish();
+      }
+    }};
+
+    int last{0};
+    bool ordered{true};
+    while (last != count) {
+      if (buffer.update()) {
+        ordered = ordered && buffer.front() > last;
+        last = buffer.front();
+      }
+    }
+    writer.join();
+    CHECK(ordered);
+    CHECK(!buffer.update());
+  }
+}
+
+TEST_CASE("testing update_motion and interpolate_vertices") {
+  boids::World world{0., 0., 100., 100., true};
+  std::vector<boids::Boid> flock{
+      boids::Boid{boids::Point{10., 20.}, boids::Point{3., 4.}},
+      boids::Boid{boids::Point{1., 50.}, boids::Point{2., 0.}}};
+  // the second boid has crossed the left edge of the world
+  std::vector<boids::Point> previous{boids::Point{7., 16.},
+                                     boids::Point{99., 50.}};
+
+  std::vector<sf::Vector2f> motion;
+  boids::update_motion(motion, flock, std::vector<int>{0, 1}, previous, world);
+  REQUIRE(motion.size() == 2);
+  CHECK(motion[0].x == doctest::Approx(3.));
+  CHECK(motion[0].y == doctest::Approx(4.));
+  CHECK(motion[1].x == doctest::Approx(2.));
+  CHECK(motion[1].y == doctest::Approx(0.));
+
+  sf::VertexArray vertices{sf::Triangles, 3 * flock.size()};
+  boids::update_vertices(vertices, flock, 5.);
+  sf::VertexArray shown{sf::Triangles};
+
+  SUBCASE("the last positions are drawn at the end of the step") {
+    boids::interpolate_vertices(shown, vertices, motion, 1.);
+    REQUIRE(shown.getVertexCount() == vertices.getVertexCount());
+    for (std::size_t i = 0; i != shown.getVertexCount(); ++i) {
+      CHECK(shown[i].position.x == vertices[i].position.x);
+      CHECK(shown[i].position.y == vertices[i].position.y);
+    }
+  }
+
+  SUBCASE("the triangles move along the displacements") {
+    boids::interpolate_vertices(shown, vertices, motion, 0.25);
+    REQUIRE(shown.getVertexCount() == vertices.getVertexCount());
+    for (std::size_t i = 0; i != shown.getVertexCount(); ++i) {
+      CHECK(shown[i].position.x ==
+            doctest::Approx(vertices[i].position.x - 0.75 * motion[i / 3].x));
+      CHECK(shown[i].position.y ==
+            doctest::Approx(vertices[i].position.y - 0.75 * motion[i / 3].y));
+    }
+  }
+}
+
+TEST_CASE("testing the level of detail") {
+  SUBCASE("choose_detail") {
+    // a 5 units boid covers 5 pixels, then 1
+    CHECK(boids::choose_detail(5., 1000, 1., 100) == boids::Detail::triangles);
+    CHECK(boids::choose_detail(5., 100, 5., 100) == boids::Detail::points);
+    CHECK(boids::choose_detail(5., 1000, 5., 100) == boids::Detail::density);
+  }
+
+  SUBCASE("Density_grid counts the birds in its cells") {
+    sf::FloatRect area{0.f, 0.f, 100.f, 50.f};
+    CHECK(boids::Density_grid::cell_count(area, 10.) == 50);
+    CHECK(boids::Density_grid::cell_count(area, 30.) == 8);
+
+    boids::Density_grid grid;
+    grid.reset(area, 10.);
+    std::vector<boids::Boid> flock{boids::Boid{boids::Point{5., 5.}},
+                                   boids::Boid{boids::Point{6., 8.}},
+                                   boids::Boid{boids::Point{95., 45.}},
+                                   boids::Boid{boids::Point{-1., 5.}},
+                                   boids::Boid{boids::Point{50., 50.}}};
+    grid.add(flock);
+    CHECK(grid.columns() == 10);
+    CHECK(grid.rows() == 5);
+    CHECK(grid.count(0, 0) == 2);
+    CHECK(grid.count(9, 4) == 1);
+    CHECK(grid.count(5, 4) == 0);
+
+    // two triangles per cell holding birds, the fullest one opaque
+    sf::VertexArray vertices;
+    grid.vertices(vertices, sf::Color::Green);
+    REQUIRE(vertices.getVertexCount() == 12);
+    CHECK(vertices.getPrimitiveType() == sf::Triangles);
+    CHECK(vertices[0].color.a == 255);
+    CHECK(vertices[6].color.a == constants::density_min_alpha);
+    CHECK(vertices[6].position.x == doctest::Approx(90.));
+    CHECK(vertices[8].position.y == doctest::Approx(50.));
+  }
+
+  SUBCASE("update_detail_vertices") {
+    std::vector<boids::Boid> flock{
+        boids::Boid{boids::Point{5., 5.}, boids::Point{1., 0.}},
+        boids::Boid{boids::Point{25., 5.}, boids::Point{0., 1.}}};
+    sf::FloatRect area{0.f, 0.f, 40.f, 10.f};
+    boids::Density_grid grid;
+    sf::VertexArray vertices;
+    boids::Detail written{boids::Detail::triangles};
+    std::vector<int> shown{0, 1};
+
+    CHECK(boids::update_detail_vertices(vertices, written, flock, shown,
+                                        boids::Detail::points, 5.,
+                                        sf::Color::Green, grid, area,
+                                        10.) == 1);
+    CHECK(written == boids::Detail::points);
+    REQUIRE(vertices.getVertexCount() == 2);
+    CHECK(vertices.getPrimitiveType() == sf::Points);
+    CHECK(vertices[1].position.x == doctest::Approx(25.));
+
+    CHECK(boids::update_detail_vertices(vertices, written, flock, shown,
+                                        boids::Detail::density, 5.,
+                                        sf::Color::Green, grid, area,
+                                        10.) == 0);
+    CHECK(vertices.getVertexCount() == 12);
+
+    // the triangles get their color back after the densities
+    CHECK(boids::update_detail_vertices(vertices, written, flock, shown,
+                                        boids::Detail::triangles, 5.,
+                                        sf::Color::Green, grid, area,
+                                        10.) == 3);
+    REQUIRE(vertices.getVertexCount() == 6);
+    CHECK(vertices.getPrimitiveType() == sf::Triangles);
+    for (std::size_t i = 0; i != 6; ++i) {
+      CHECK(vertices[i].color == sf::Color::Green);
+    }
+
+    // even if there are as many triangle vertices as density ones: four
+    // birds in two cells, the sparse one translucent
+    flock.push_back(boids::Boid{boids::Point{6., 6.}, boids::Point{0., 1.}});
+    flock.push_back(boids::Boid{boids::Point{7., 7.}, boids::Point{0., 1.}});
+    shown = {0, 1, 2, 3};
+    CHECK(boids::update_detail_vertices(vertices, written, flock, shown,
+                                        boids::Detail::density, 5.,
+                                        sf::Color::Green, grid, area,
+                                        10.) == 0);
+    REQUIRE(vertices.getVertexCount() == 12);
+    REQUIRE(vertices.getPrimitiveType() == sf::Triangles);
+    CHECK((vertices[0].color.a < 255 || vertices[6].color.a < 255));
+    CHECK(boids::update_detail_vertices(vertices, written, flock, shown,
+                                        boids::Detail::triangles, 5.,
+                                        sf::Color::Green, grid, area,
+                                        10.) == 3);
+    for (std::size_t i = 0; i != 12; ++i) {
+      CHECK(vertices[i].color == sf::Color::Green);
+    }
+  }
+
+  SUBCASE("points are interpolated like triangles") {
+    std::vector<boids::Boid> flock{boids::Boid{boids::Point{5., 5.}}};
+    sf::VertexArray vertices;
+    boids::update_points(vertices, flock, std::vector<int>{0},
+                         sf::Color::Green);
+    std::vector<sf::Vector2f> motion{sf::Vector2f{2.f, -4.f}};
+    sf::VertexArray shown;
+    boids::interpolate_vertices(shown, vertices, motion, 0.5);
+    REQUIRE(shown.getVertexCount() == 1);
+    CHECK(shown.getPrimitiveType() == sf::Points);
+    CHECK(shown[0].position.x == doctest::Approx(4.));
+    CHECK(shown[0].position.y == doctest::Approx(7.));
+  }
+
+  SUBCASE("a zoomed in view only gets the birds it can see") {
+    boids::World world{0., 0., 1000., 1000., true};
+    auto flock = test_flock(5000, boids::Rectangle{500., 500., 500., 500.});
+    sf::FloatRect area{100.f, 200.f, 50.f, 40.f};
+    std::vector<int> visible;
+    boids::visible_birds(visible, flock, area, 10., {}, world);
+    REQUIRE(!visible.empty());
+    REQUIRE(visible.size() < flock.size() / 10);
+    CHECK(std::is_sorted(visible.begin(), visible.end()));
+    for (int i = 0; i != static_cast<int>(flock.size()); ++i) {
+      double x = flock[i].pos().x();
+      double y = flock[i].pos().y();
+      bool near = x >= 90. && x <= 160. && y >= 190. && y <= 250.;
+      CHECK(near == std::binary_search(visible.begin(), visible.end(), i));
+    }
+
+    // three vertices per bird in view, whatever the size of the flock
+    sf::VertexArray vertices;
+    boids::Detail written{boids::Detail::triangles};
+    boids::Density_grid grid;
+    CHECK(boids::update_detail_vertices(vertices, written, flock, visible,
+                                        boids::Detail::triangles, 5.,
+                                        sf::Color::Green, grid, area,
+                                        1.) == 3);
+    REQUIRE(vertices.getVertexCount() == 3 * visible.size());
+    CHECK(vertices[0].position.x ==
+          doctest::Approx(flock[visible[0]].pos().x()).epsilon(0.1));
+
+    // a bird that has just left the view is drawn on its way out
+    std::vector<boids::Boid> leaving{
+        boids::Boid{boids::Point{200., 220.}, boids::Point{60., 0.}}};
+    std::vector<boids::Point> previous{boids::Point{140., 220.}};
+    boids::visible_birds(visible, leaving, area, 10., previous, world);
+    CHECK(visible.size() == 1);
+    boids::visible_birds(visible, leaving, area, 10., {}, world);
+    CHECK(visible.empty());
+  }
+}
+
+TEST_CASE("testing Bird_renderer") {
+  // nothing is drawn: the tests may run without a graphics context
+  SUBCASE("the vertex buffer can be turned off") {
+    boids::Bird_renderer renderer{false};
+    CHECK(!renderer.uses_buffer());
+  }
+
+  SUBCASE("the vertex buffer is only used if available") {
+    boids::Bird_renderer renderer{true};
+    CHECK(renderer.uses_buffer() == sf::VertexBuffer::isAvailable());
+  }
+}
+
+TEST_CASE("testing Recorder and Recording") {
+  const std::string path{"boids.test.recording"};
+  boids::World world{100., 50., 800., 600., false};
+  boids::Rectangle rect{500., 350., 400., 300.};
+  auto flock = test_flock(5000, rect);
+  std::mt19937 mt{7};
+  std::uniform_real_distribution<double> speed{-2., 2.};
+  for (auto& boid : flock) {
+    boid = boids::Boid{boid.pos(), boids::Point{speed(mt), speed(mt)}};
+  }
+  std::vector<boids::Predator> predators{
+      boids::Predator{boids::Point{200., 300.}, boids::Point{-1., 0.5}}};
+  boids::Handles boid_handles;
+  boids::Handles predator_handles;
+  boid_handles.spawn(static_cast<int>(flock.size()));
+  predator_handles.spawn(1);
+
+  // boids of each recorded step, in the order of their handles
+  std::map<std::uint64_t, std::vector<boids::Boid>> recorded;
+  constexpr int steps{200};
+  constexpr int period{2};
+  {
+    boids::Recorder recorder{path, world, period};
+    for (int step = 0; step != steps; ++step) {
+      for (auto& boid : flock) {
+        boid = boids::Boid{boid.pos() + boid.vel(), boid.vel()};
+      }
+      // the vector gets reordered and shrinks, handles keep the order
+      if (step == 51) {
+        boid_handles.reorder(boids::spatial_sort(flock, rect));
+      }
+      if (step == 101) {
+        flock.resize(4000);
+        boid_handles.retire(1000);
+      }
+      auto& by_handle = recorded[step];
+      for (int handle = 0; handle != boid_handles.capacity(); ++handle) {
+        if (boid_handles.index(handle) != -1) {
+          by_handle.push_back(flock[boid_handles.index(handle)]);
+        }
+      }
+      recorder.record(step, flock, boid_handles, predators, predator_handles);
+    }
+    CHECK(recorder.close());
+    // frames are only dropped if the writer falls behind
+    CHECK(recorder.dropped() < steps / period);
+  }
+
+  boids::Recording recording{path};
+  const auto& header = recording.header();
+  CHECK(header.period == period);
+  REQUIRE(recording.frame_count() > 0);
+  REQUIRE(recording.frame_count() <= steps / period);
+
+  auto check_frame = [&](std::uint64_t index) {
+    const auto& frame = recording.frame(index);
+    CHECK(frame.step % period == 0);
+    const auto& boids = recorded[frame.step];
+    REQUIRE(frame.boids.size() == 4 * boids.size());
+    // values are rounded to the closest multiple of the quantum
+    auto close = [](double value, double expected, double quantum) {
+      return std::abs(value - expected) <= quantum / 2. + 1e-9;
+    };
+    double position_quantum = header.position_quantum;
+    for (std::size_t i = 0; i != boids.size(); ++i) {
+      CHECK(close(header.min_x + frame.boids[4 * i] * position_quantum,
+                  boids[i].pos().x(), position_quantum));
+      CHECK(close(header.min_y + frame.boids[4 * i + 1] * position_quantum,
+                  boids[i].pos().y(), position_quantum));
+      CHECK(close(frame.boids[4 * i + 2] * header.velocity_quantum,
+                  boids[i].vel().x(), header.velocity_quantum));
+      CHECK(close(frame.boids[4 * i + 3] * header.velocity_quantum,
+                  boids[i].vel().y(), header.velocity_quantum));
+    }
+    REQUIRE(frame.predators.size() == 4);
+    CHECK(frame.predators[3] * header.velocity_quantum == 0.5);
+  };
+
+  SUBCASE("frames are read forward") {
+    for (std::uint64_t i = 0; i != recording.frame_count(); ++i) {
+      check_frame(i);
+    }
+  }
+
+  SUBCASE("frames are read in any order") {
+    auto count = recording.frame_count();
+    for (auto i : {count - 1, count / 2, std::uint64_t{0}, count / 3, count / 2 + 1}) {
+      check_frame(i);
+    }
+  }
+
+  SUBCASE("frames are read backward and skipped, from their keyframes") {
+    for (auto i = recording.frame_count(); i-- != 0;) {
+      check_frame(i);
+    }
+    // jumps over a keyframe, and forward within a keyframe period
+    for (std::uint64_t i = 0; i < recording.frame_count();
+         i += constants::recording_keyframe_period + 3) {
+      check_frame(i);
+      if (i + 2 < recording.frame_count()) {
+        check_frame(i + 2);
+      }
+    }
+  }
+
+  SUBCASE("frames are replayed into vertex arrays") {
+    sf::VertexArray boid_vertex{sf::Triangles};
+    sf::VertexArray predator_vertex{sf::Triangles};
+    const auto& frame = recording.frame(0);
+    boids::replay_vertices(frame, header, boid_vertex, predator_vertex);
+    REQUIRE(boid_vertex.getVertexCount() == 3 * 5000);
+    REQUIRE(predator_vertex.getVertexCount() == 3);
+
+    // the tip of the triangle is ahead of the bird, as for vertex_update
+    const auto& boid = recorded[frame.step][0];
+    sf::VertexArray expected{sf::Triangles, 3};
+    boids::vertex_update(expected, boid, 0, constants::boid_size);
+    CHECK(boid_vertex[0].position.x ==
+          doctest::Approx(expected[0].position.x).epsilon(1e-3));
+    CHECK(boid_vertex[0].position.y ==
+          doctest::Approx(expected[0].position.y).epsilon(1e-3));
+    CHECK(boid_vertex[0].color == constants::boid_color);
+  }
+
+  SUBCASE("incomplete chunks are skipped") {
+    auto frame_count = recording.frame_count();
+    std::ifstream file{path, std::ios::binary};
+    std::string content{std::istreambuf_iterator<char>{file},
+                        std::istreambuf_iterator<char>{}};
+    file.close();
+    std::ofstream truncated{path, std::ios::binary | std::ios::trunc};
+    truncated.write(content.data(), content.size() - 1);
+    truncated.close();
+
+    boids::Recording truncated_recording{path};
+    CHECK(truncated_recording.frame_count() < frame_count);
+    CHECK(truncated_recording.frame_count() > 0);
+  }
+
+  SUBCASE("the differences take less space than the values") {
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    auto bytes_per_value = static_cast<double>(file.tellg()) /
+                           (recording.frame_count() * 4 * 4000);
+    CHECK(bytes_per_value < 2.);
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("testing Frame_writer") {
+  // a frame of 3x2 pixels, the bytes numbered from 0
+  std::vector<sf::Uint8> pixels(4 * 3 * 2);
+  for (std::size_t i = 0; i != pixels.size(); ++i) {
+    pixels[i] = static_cast<sf::Uint8>(i);
+  }
+  sf::Image image;
+  image.create(3, 2, pixels.data());
+  constexpr int frames{2 * constants::export_queue_size + 1};
+
+  SUBCASE("raw frames follow each other in a single file") {
+    std::string path = std::string{"./"} + constants::export_raw_file;
+    {
+      boids::Frame_writer writer{".", true};
+      for (int i = 0; i != frames; ++i) {
+        writer.write(image);
+      }
+      CHECK(writer.close());
+      CHECK(writer.written() == frames);
+    }
+    std::ifstream file{path, std::ios::binary};
+    std::string content{std::istreambuf_iterator<char>{file},
+                        std::istreambuf_iterator<char>{}};
+    file.close();
+    REQUIRE(content.size() == frames * pixels.size());
+    for (std::size_t i = 0; i != content.size(); ++i) {
+      CHECK(static_cast<sf::Uint8>(content[i]) ==
+            pixels[i % pixels.size()]);
+    }
+    std::remove(path.c_str());
+  }
+
+  SUBCASE("frames are numbered files") {
+    {
+      boids::Frame_writer writer{".", false};
+      writer.write(image);
+      writer.write(image);
+      CHECK(writer.close());
+      CHECK(writer.written() == 2);
+    }
+    for (auto name : {"./frame_000000.png", "./frame_000001.png"}) {
+      std::ifstream file{name};
+      CHECK(static_cast<bool>(file));
+      file.close();
+      std::remove(name);
+    }
+  }
+
+  SUBCASE("the directory has to exist") {
+    CHECK_THROWS_AS(boids::Frame_writer("boids.test.missing", true),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("testing Spsc_queue") {
+  boids::Spsc_queue<int, 4> queue;
+  int value{-1};
+  CHECK(!queue.pop(value));
+  CHECK(value == -1);
+
+  SUBCASE("values come out in the order they went in") {
+    // the indices wrap around the slots several times
+    for (int i = 0; i != 10; ++i) {
+      CHECK(queue.push(2 * i));
+      CHECK(queue.push(2 * i + 1));
+      CHECK(queue.pop(value));
+      CHECK(value == 2 * i);
+      CHECK(queue.pop(value));
+      CHECK(value == 2 * i + 1);
+    }
+    CHECK(!queue.pop(value));
+  }
+
+  SUBCASE("a full queue refuses values") {
+    for (int i = 0; i != 4; ++i) {
+      CHECK(queue.push(i));
+    }
+    CHECK(!queue.push(4));
+    CHECK(queue.pop(value));
+    CHECK(value == 0);
+    CHECK(queue.push(4));
+    for (int i = 1; i != 5; ++i) {
+      CHECK(queue.pop(value));
+      CHECK(value == i);
+    }
+  }
+
+  SUBCASE("values pushed by another thread arrive once and in order") {
+    constexpr int count{10000};
+    std::thread producer{[&queue] {
+      for (int i = 1; i <= count;) {
+        if (queue.push(i)) {
+          ++i;
+        }
+      }
+    }};
+
+    int last{0};
+    bool ordered{true};
+    while (last != count) {
+      if (queue.pop(value)) {
+        ordered = ordered && value == last + 1;
+        last = value;
+      }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(!queue.pop(value));
+  }
+}
+
+// memory used by the simulation per boid, with the provided handles, index
+// and neighbour lists. main.cpp also keeps, per boid: the vertices and the
+// displacements of the three frames of the Triple_buffer, the interpolated
+// vertices of the window, the positions before the step, the distances and
+// speeds of the statistics and the indices of the birds in view. the vertex
+// buffer of Bird_renderer is in the memory of the graphics card
+template <class Index>
+double memory_per_boid(const std::vector<boids::Boid>& flock,
+                       const boids::Handles& handles, const Index& index,
+                       const boids::Verlet_list& verlet_list) {
+  const std::size_t main_per_boid =
+      3 * (3 * sizeof(sf::Vertex) + sizeof(sf::Vector2f)) +
+      3 * sizeof(sf::Vertex) + sizeof(boids::Point) + 2 * sizeof(double) +
+      sizeof(int);
+  std::size_t bytes = flock.capacity() * sizeof(boids::Boid) +
+                      handles.memory_usage() + main_per_boid * flock.size() +
+                      index.memory_usage() + verlet_list.memory_usage();
+  return static_cast<double>(bytes) / flock.size();
+}
+
+TEST_CASE("testing the memory per boid") {
+  // uniform flock with about ten boids in range
+  constexpr int size{20000};
+  constexpr double range{40.};
+  double side = std::sqrt(size * constants::pi * range * range / 10.);
+  boids::Rectangle rect{side / 2., side / 2., side / 2., side / 2.};
+  std::mt19937 mt{3};
+  std::uniform_real_distribution<double> coordinate{0., side};
+  std::vector<boids::Boid> flock;
+  flock.reserve(size);
+  for (int i = 0; i != size; ++i) {
+    flock.push_back(boids::Boid{boids::Point{coordinate(mt), coordinate(mt)}});
+  }
+
+  boids::Handles handles;
+  handles.spawn(size);
+  boids::Verlet_list verlet_list{constants::verlet_skin};
+
+  SUBCASE("quad tree") {
+    boids::Quad_tree tree{constants::cell_capacity, rect};
+    for (const auto& boid : flock) {
+      tree.insert(boid);
+    }
+    verlet_list.build(tree, flock, range);
+    CHECK(memory_per_boid(flock, handles, tree, verlet_list) <
+          constants::memory_per_boid_budget);
+  }
+
+  SUBCASE("linear quad tree") {
+    boids::Linear_quad_tree tree{constants::cell_capacity, rect};
+    tree.build(flock);
+    verlet_list.build(tree, flock, range);
+    CHECK(memory_per_boid(flock, handles, tree, verlet_list) <
+          constants::memory_per_boid_budget);
+  }
+
+  SUBCASE("k-d tree") {
+    boids::Kd_tree tree{constants::cell_capacity};
+    tree.build(flock);
+    verlet_list.build(tree, flock, range);
+    CHECK(memory_per_boid(flock, handles, tree, verlet_list) <
+          constants::memory_per_boid_budget);
   }
 }
 
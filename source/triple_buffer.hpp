@@ -0,0 +1,55 @@
+// hands the latest value from a writer thread to a reader thread without
+// locks. the writer fills the back slot and publishes it, the reader takes
+// the most recently published one: neither ever waits for the other, the
+// writer never touches the slot being read, and published values the reader
+// had no time to take are simply skipped.
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+
+namespace boids {
+
+// template class, for any value that is reused from slot to slot
+template <class T>
+class Triple_buffer {
+  // set in m_middle when its slot was published after the last update()
+  static constexpr int fresh_bit{4};
+
+  std::array<T, 3> m_slots{};
+
+  // the slot owned by the writer, the one owned by the reader, and the one
+  // exchanged between them, with fresh_bit
+  int m_back{0};
+  int m_front{1};
+  std::atomic<int> m_middle{2};
+
+ public:
+  // returns the slot the writer fills. it still holds the value it had when
+  // it was last read or written, so its memory can be reused
+  T& back() { return m_slots[m_back]; }
+
+  // publishes the back slot, and gives the writer another one. called by the
+  // writer only
+  void publish() {
+    m_back = m_middle.exchange(m_back | fresh_bit, std::memory_order_acq_rel) &
+             ~fresh_bit;
+  }
+
+  // takes the last published slot, if it was not taken yet. returns true if
+  // front() changed. called by the reader only
+  bool update() {
+    if ((m_middle.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+      return false;
+    }
+    m_front =
+        m_middle.exchange(m_front, std::memory_order_acq_rel) & ~fresh_bit;
+    return true;
+  }
+
+  // returns the slot the reader uses, the last one taken by update()
+  T& front() { return m_slots[m_front]; }
+};
+}  // namespace boids
+#endif
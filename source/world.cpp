@@ -0,0 +1,77 @@
+#include "world.hpp"
+
+#include <array>
+#include <cassert>
+#include <cmath>  //for floor, round
+
+#include "point.hpp"
+
+namespace boids {
+namespace {
+// returns the value brought inside [lowest, lowest + size)
+double wrap_coordinate(double value, double lowest, double size) {
+  double wrapped = value - size * std::floor((value - lowest) / size);
+  // rounding may give exactly lowest + size
+  return wrapped < lowest + size ? wrapped : lowest;
+}
+
+// returns the difference brought inside [-size / 2, size / 2]
+double shortest_difference(double difference, double size) {
+  return difference - size * std::round(difference / size);
+}
+}  // namespace
+
+Point World::wrap(const Point& p) const {
+  if (!toroidal) {
+    return p;
+  }
+  assert(width > 0. && height > 0.);
+  return Point{wrap_coordinate(p.x(), min_x, width),
+               wrap_coordinate(p.y(), min_y, height)};
+}
+
+Point World::displacement(const Point& a, const Point& b) const {
+  if (!toroidal) {
+    return a - b;
+  }
+  assert(width > 0. && height > 0.);
+  return Point{shortest_difference(a.x() - b.x(), width),
+               shortest_difference(a.y() - b.y(), height)};
+}
+
+int World::images(const Point& p, double range,
+                  std::array<Point, 4>& images) const {
+  assert(range >= 0.);
+  images[0] = p;
+  if (!toroidal) {
+    return 1;
+  }
+  assert(2. * range <= width && 2. * range <= height);
+
+  // the images are shifted towards the side the range crosses
+  double shift_x{0.};
+  if (p.x() - range < min_x) {
+    shift_x = width;
+  } else if (p.x() + range >= min_x + width) {
+    shift_x = -width;
+  }
+  double shift_y{0.};
+  if (p.y() - range < min_y) {
+    shift_y = height;
+  } else if (p.y() + range >= min_y + height) {
+    shift_y = -height;
+  }
+
+  int count{1};
+  if (shift_x != 0.) {
+    images[count++] = p + Point{shift_x, 0.};
+  }
+  if (shift_y != 0.) {
+    images[count++] = p + Point{0., shift_y};
+  }
+  if (shift_x != 0. && shift_y != 0.) {
+    images[count++] = p + Point{shift_x, shift_y};
+  }
+  return count;
+}
+}  // namespace boids
@@ -0,0 +1,50 @@
+// geometry of the area where the birds fly. in a toroidal world the opposite
+// sides are joined: birds leaving from one side reenter from the other, and
+// interact with the birds across the edges by taking the shortest way around
+// (minimum image convention).
+#ifndef WORLD_HPP
+#define WORLD_HPP
+
+#include <array>
+
+#include "constants.hpp"
+#include "point.hpp"
+
+namespace boids {
+struct World {
+  // the world is [min_x, min_x + width) x [min_y, min_y + height)
+  double min_x{};
+  double min_y{};
+  double width{};
+  double height{};
+  bool toroidal{false};
+
+  // returns the point brought back inside the world, if toroidal. otherwise
+  // the point is returned unchanged
+  // Param 1: the point
+  Point wrap(const Point&) const;
+
+  // returns the vector from the second point to the first. if toroidal, the
+  // shortest one among the vectors to the images of the first point
+  // Param 1: the first point
+  // Param 2: the second point
+  Point displacement(const Point&, const Point&) const;
+
+  // fills the array with the periodic images of the point (the point itself
+  // first) that are closer than the range to the world, so that a search
+  // around all of them finds every point within range across the edges.
+  // returns their number, 1 if the world is not toroidal. the range must be
+  // less than half the sides of the world.
+  // Param 1: the point, inside the world
+  // Param 2: the range
+  // Param 3: the array of images
+  int images(const Point&, double, std::array<Point, 4>&) const;
+};
+
+// the default world: the window, without the control panel
+inline constexpr World window_world{
+    constants::controls_width, 0.,
+    constants::window_width - constants::controls_width,
+    constants::window_height, constants::toroidal_world};
+}  // namespace boids
+#endif